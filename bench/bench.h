@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct bench_result {
+	std::string name;
+	double value;
+	std::string unit;
+};
+
+// every reported number, written out as JSON at the end of the run
+inline std::vector<bench_result> bench_results;
+
+// shortest time each measurement runs for; set from the command line
+inline double bench_min_seconds = 0.5;
+
+// fastest of several samples, which is far less noisy than the mean on a shared machine
+template <typename F>
+double seconds_per_run(F&& run) {
+	using clock = std::chrono::steady_clock;
+	const int samples = 5;
+	double best = 0;
+
+	for (int sample = 0; sample < samples; sample++) {
+		size_t runs = 0;
+		auto start = clock::now();
+		double elapsed = 0;
+		do {
+			run();
+			runs++;
+			elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		} while (elapsed < bench_min_seconds / samples);
+		if (sample == 0 || elapsed / runs < best)
+			best = elapsed / runs;
+	}
+	return best;
+}
+
+inline void report(const std::string& name, double per_second, const char* unit) {
+	std::printf("%-44s %14.0f %s/s\n", name.c_str(), per_second, unit);
+	bench_results.push_back({ name, per_second, std::string(unit) + "/s" });
+}
+
+inline void report_value(const std::string& name, double value, const char* unit) {
+	std::printf("%-44s %14.1f %s\n", name.c_str(), value, unit);
+	bench_results.push_back({ name, value, unit });
+}
+
+// a formula of at least the given number of tokens, always the same for the same count
+std::string generate_formula(size_t tokens);
+size_t count_tokens(const std::string& formula);
+
+// compares bench_results with a file written by --json; returns how many benchmarks regressed
+size_t compare_with_baseline(const char* path, double tolerance);
+// the kernel set the baseline was recorded with, empty when the file doesn't say
+std::string baseline_isa(const char* path);
+
+void bench_phases();
+void bench_program_file();
+void bench_literals();
@@ -0,0 +1,126 @@
+#include "bench.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+struct baseline_entry {
+	std::string name;
+	double value = 0;
+	std::string unit;
+	double tolerance = -1;
+};
+
+static std::string read_file(const char* path) {
+	std::ifstream in(path);
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	return in ? buffer.str() : std::string();
+}
+
+static std::string read_string(const std::string& text, size_t& at) {
+	size_t begin = text.find('"', at) + 1;
+	size_t end = text.find('"', begin);
+	at = end + 1;
+	return text.substr(begin, end - begin);
+}
+
+std::string baseline_isa(const char* path) {
+	std::string text = read_file(path);
+	size_t context = text.find("\"context\"");
+	if (context == std::string::npos)
+		return "";
+	size_t end = text.find('}', context);
+	size_t position = text.find("\"isa\"", context);
+	if (position == std::string::npos || position > end)
+		return "";
+	position = text.find(':', position) + 1;
+	return read_string(text, position);
+}
+
+// reads the objects of the "benchmarks" array; enough for files written by --json
+static std::vector<baseline_entry> read_baseline(const char* path) {
+	std::string text = read_file(path);
+	std::vector<baseline_entry> entries;
+
+	size_t position = text.find("\"benchmarks\"");
+	if (position == std::string::npos)
+		return entries;
+
+	while ((position = text.find('{', position)) != std::string::npos) {
+		size_t end = text.find('}', position);
+		baseline_entry entry;
+
+		while (true) {
+			size_t key = text.find('"', position);
+			if (key == std::string::npos || key > end)
+				break;
+			position = key;
+			std::string name = read_string(text, position);
+			position = text.find(':', position) + 1;
+			while (text[position] == ' ')
+				position++;
+
+			if (text[position] == '"') {
+				std::string value = read_string(text, position);
+				if (name == "name")
+					entry.name = value;
+				else if (name == "unit")
+					entry.unit = value;
+			}
+			else {
+				char* number_end;
+				double value = std::strtod(text.c_str() + position, &number_end);
+				position = number_end - text.c_str();
+				if (name == "value")
+					entry.value = value;
+				else if (name == "tolerance")
+					entry.tolerance = value;
+			}
+		}
+		if (!entry.name.empty())
+			entries.push_back(entry);
+		position = end + 1;
+	}
+	return entries;
+}
+
+size_t compare_with_baseline(const char* path, double tolerance) {
+	std::vector<baseline_entry> baseline = read_baseline(path);
+	std::map<std::string, const bench_result*> current;
+	size_t regressions = 0;
+
+	if (baseline.empty()) {
+		std::printf("baseline %s has no benchmarks\n", path);
+		return 1;
+	}
+	for (const bench_result& result : bench_results)
+		current[result.name] = &result;
+
+	std::printf("\n%-44s %14s %14s %8s %8s\n", "benchmark", "baseline", "current", "delta", "allowed");
+	for (const baseline_entry& entry : baseline) {
+		auto found = current.find(entry.name);
+		if (found == current.end()) {
+			std::printf("%-44s %14.0f %14s %8s %8s  MISSING\n", entry.name.c_str(), entry.value, "-", "-", "-");
+			regressions++;
+			continue;
+		}
+
+		const bench_result& result = *found->second;
+		double allowed = entry.tolerance >= 0 ? entry.tolerance : tolerance;
+		double delta = result.value / entry.value - 1;
+		// rates are better when higher, everything else (bytes, allocations) when lower
+		bool higher_is_better = entry.unit.size() > 2 && entry.unit.compare(entry.unit.size() - 2, 2, "/s") == 0;
+		bool regressed = higher_is_better ? delta < -allowed : delta > allowed;
+
+		std::printf("%-44s %14.0f %14.0f %+7.1f%% %7.0f%%  %s\n", entry.name.c_str(), entry.value, result.value,
+			delta * 100, allowed * 100, regressed ? "REGRESSED" : "ok");
+		regressions += regressed;
+	}
+
+	if (regressions != 0)
+		std::printf("\n%zu of %zu benchmarks regressed against %s\n", regressions, baseline.size(), path);
+	return regressions;
+}
@@ -0,0 +1,174 @@
+#include "bench.h"
+#include "expression.h"
+#include "expression_cache.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static void write_json(const char* path) {
+	FILE* out = std::fopen(path, "w");
+	if (out == nullptr) {
+		std::fprintf(stderr, "can't write %s\n", path);
+		return;
+	}
+
+	std::fprintf(out, "{\n  \"context\": {\"isa\": \"%s\", \"threads\": %u, \"min_seconds\": %g},\n  \"benchmarks\": [\n",
+		kernels::name(kernels::best_isa()), std::thread::hardware_concurrency(), bench_min_seconds);
+	for (size_t i = 0; i < bench_results.size(); i++) {
+		const bench_result& result = bench_results[i];
+		std::fprintf(out, "    {\"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}%s\n",
+			result.name.c_str(), result.value, result.unit.c_str(), i + 1 < bench_results.size() ? "," : "");
+	}
+	std::fprintf(out, "  ]\n}\n");
+	std::fclose(out);
+}
+
+static void bench_evaluate() {
+	expression repeated("(a-b)/(a-b+c)*(a-b)+[(a-b)*c-(a-b+c)]/{(a-b)*c}", { {"a", 5}, {"b", 3}, {"c", 2} });
+	double repeated_seconds = seconds_per_run([&] { repeated.calculate(); });
+	report("calculate repeated subterms", 1 / repeated_seconds, "calls");
+
+	expression folded("(3+4)*2*pi/[e-1]");
+	double folded_seconds = seconds_per_run([&] { folded.calculate(); });
+	report("calculate constant formula", 1 / folded_seconds, "calls");
+
+	const size_t rows = 1000000;
+	std::vector<double> x(rows), y(rows), z(rows), w(rows), result(rows);
+	for (size_t i = 0; i < rows; i++) {
+		x[i] = i * 0.001;
+		y[i] = 1.0 + i % 7;
+		z[i] = 2.0 - i % 3;
+		w[i] = 0.5;
+	}
+	expression risk("(x*0.3+y*0.5-z/y)*w");
+	for (kernels::isa set : { kernels::isa::scalar, kernels::isa::sse2, kernels::isa::avx2, kernels::isa::avx512 }) {
+		if (!kernels::is_supported(set))
+			continue;
+		kernels::select(set);
+		double seconds = seconds_per_run([&] { risk.calculate({ {"x", {x.data()}}, {"y", {y.data()}}, {"z", {z.data()}}, {"w", {w.data()}} }, result.data(), rows); });
+		report(std::string("batch calculate 1M rows ") + kernels::name(set), rows / seconds, "rows");
+	}
+	kernels::select(kernels::best_isa());
+
+	const size_t big_rows = 16 * rows;
+	std::vector<double> big_x(big_rows, 1.5), big_y(big_rows, 2.0), big_z(big_rows, 3.0), big_w(big_rows, 0.5), big_result(big_rows);
+	size_t max_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	for (size_t threads = 1; threads <= max_threads; threads++) {
+		thread_pool pool(threads);
+		double seconds = seconds_per_run([&] { risk.calculate({ {big_x.data()}, {big_y.data()}, {big_z.data()}, {big_w.data()} }, big_result.data(), big_rows, pool); });
+		report("parallel batch 16M rows " + std::to_string(threads) + " threads", big_rows / seconds, "rows");
+	}
+
+	expression native_risk(risk);
+	if (native_risk.compile_native()) {
+		double seconds = seconds_per_run([&] { native_risk.calculate({ {"x", {x.data()}}, {"y", {y.data()}}, {"z", {z.data()}}, {"w", {w.data()}} }, result.data(), rows); });
+		report("batch calculate 1M rows jit", rows / seconds, "rows");
+	}
+
+	expression row("(x*0.3+y*0.5-z/y)*w", { {"x", 1}, {"y", 2}, {"z", 3}, {"w", 0.5} });
+	double seconds = seconds_per_run([&] { row.calculate(); });
+	report("row-by-row calculate", 1 / seconds, "rows");
+	if (row.compile_native()) {
+		seconds = seconds_per_run([&] { row.calculate(); });
+		report("row-by-row calculate jit", 1 / seconds, "rows");
+	}
+
+	double frame[] = { 1, 2, 3, 0.5 };
+	seconds = seconds_per_run([&] { row.calculate(frame); });
+	report("calculate with binding frame", 1 / seconds, "rows");
+
+	// one row in twenty divides by zero: exceptions per row against the error bitmap
+	expression ratio("x/z");
+	std::vector<double> divisors(rows);
+	for (size_t i = 0; i < rows; i++)
+		divisors[i] = i % 20 == 0 ? 0 : z[i] + 2;
+	const size_t thrown_rows = rows / 10;
+	seconds = seconds_per_run([&] {
+		double values[2];
+		for (size_t i = 0; i < thrown_rows; i++) {
+			values[0] = x[i];
+			values[1] = divisors[i];
+			try {
+				result[i] = ratio.calculate(values);
+			}
+			catch (const char*) {
+				result[i] = 0;
+			}
+		}
+	});
+	report("row-by-row with 5% division by zero throwing", thrown_rows / seconds, "rows");
+	seconds = seconds_per_run([&] {
+		double values[2];
+		for (size_t i = 0; i < thrown_rows; i++) {
+			values[0] = x[i];
+			values[1] = divisors[i];
+			result[i] = ratio.try_calculate(values).value_or(0);
+		}
+	});
+	report("row-by-row with 5% division by zero try_calculate", thrown_rows / seconds, "rows");
+	row_errors errors;
+	seconds = seconds_per_run([&] { ratio.try_calculate({ {x.data()}, {divisors.data()} }, result.data(), rows, errors); });
+	report("batch 1M rows with 5% division by zero", rows / seconds, "rows");
+
+	const size_t elements = 1000000;
+	expression prototype("(x*0.3+y*0.5-z/y)*w", { {"x", 1}, {"y", 2}, {"z", 3}, {"w", 4} });
+	seconds = seconds_per_run([&] {
+		std::vector<expression> formulas;
+		for (size_t i = 0; i < elements; i++)
+			formulas.push_back(prototype);
+	});
+	report("vector<expression> growth 1M", elements / seconds, "elements");
+}
+
+int main(int argc, char** argv) {
+	const std::pair<const char*, void (*)()> suites[] = {
+		{ "phases", bench_phases },
+		{ "program_file", bench_program_file },
+		{ "evaluate", bench_evaluate },
+		{ "literals", bench_literals },
+	};
+	std::vector<std::string> selected;
+	const char* json = nullptr;
+	const char* baseline = nullptr;
+	double tolerance = 0.3;
+
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		if (argument == "--json" && i + 1 < argc)
+			json = argv[++i];
+		else if (argument == "--min-time" && i + 1 < argc)
+			bench_min_seconds = std::atof(argv[++i]);
+		else if (argument == "--suite" && i + 1 < argc)
+			selected.push_back(argv[++i]);
+		else if (argument == "--baseline" && i + 1 < argc)
+			baseline = argv[++i];
+		else if (argument == "--tolerance" && i + 1 < argc)
+			tolerance = std::atof(argv[++i]);
+		else {
+			std::fprintf(stderr, "usage: %s [--suite phases|program_file|evaluate|literals]... [--min-time <seconds>]\n"
+				"       [--json <file>] [--baseline <file> [--tolerance <fraction>]]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	// timings only compare within one dispatch path; ctest reports this exit code as skipped
+	if (baseline != nullptr && baseline_isa(baseline) != kernels::name(kernels::best_isa())) {
+		std::printf("baseline %s was recorded with %s kernels, this machine dispatches to %s: skipping\n",
+			baseline, baseline_isa(baseline).c_str(), kernels::name(kernels::best_isa()));
+		return 77;
+	}
+
+	for (const auto& suite : suites) {
+		if (selected.empty() || std::find(selected.begin(), selected.end(), suite.first) != selected.end())
+			suite.second();
+	}
+
+	if (json != nullptr)
+		write_json(json);
+	if (baseline != nullptr)
+		return compare_with_baseline(baseline, tolerance) == 0 ? 0 : 1;
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "expression.h"
+#include "literal.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+void bench_literals() {
+	const size_t count = 100000;
+	std::mt19937_64 random(7);
+	std::vector<std::string> texts;
+	std::string formula;
+
+	// the shapes numbers take in real formulas: short integers, fixed point and scientific notation
+	for (size_t i = 0; i < count; i++) {
+		char text[64];
+		switch (i % 4) {
+		case 0:
+			std::snprintf(text, sizeof(text), "%u", (unsigned)(random() % 1000));
+			break;
+		case 1:
+			std::snprintf(text, sizeof(text), "%.3f", (random() % 1000000) / 1000.0);
+			break;
+		case 2:
+			std::snprintf(text, sizeof(text), "%.6e", (random() % 1000000) * 1e-9);
+			break;
+		default:
+			std::snprintf(text, sizeof(text), "%.17g", (double)random() / 3);
+			break;
+		}
+		texts.push_back(text);
+		formula += (i == 0 ? "" : "+") + texts.back() + "*x";
+	}
+
+	double sum = 0;
+	double seconds = seconds_per_run([&] {
+		for (const std::string& text : texts)
+			sum += std::stod(text);
+	});
+	report("std::stod 100k literals", count / seconds, "literals");
+
+	seconds = seconds_per_run([&] {
+		double value;
+		for (const std::string& text : texts)
+			sum += literal::parse(text, value) ? value : 0;
+	});
+	report("literal::parse 100k literals", count / seconds, "literals");
+
+	seconds = seconds_per_run([&] { expression::compiled program(formula); });
+	report("parse formula with 100k literals", count / seconds, "literals");
+
+	if (sum == 0)
+		std::printf("%f\n", sum);
+}
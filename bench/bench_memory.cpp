@@ -0,0 +1,63 @@
+// Built as its own executable: it replaces the global operator new to count allocations, which would
+// otherwise slow down every timing suite that shares the binary.
+
+#include "bench.h"
+#include "expression.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// instrumented builds already replace operator new to count allocations per phase
+#ifndef EXPRESSION_INSTRUMENTATION
+static std::atomic<long long> live_bytes{ 0 };
+static std::atomic<long long> allocations{ 0 };
+
+void* operator new(size_t size) {
+	void* memory = std::malloc(size + 16);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	*(size_t*)memory = size;
+	live_bytes += size;
+	allocations++;
+	return (char*)memory + 16;
+}
+
+void operator delete(void* pointer) noexcept {
+	if (pointer == nullptr)
+		return;
+	void* memory = (char*)pointer - 16;
+	live_bytes -= *(size_t*)memory;
+	std::free(memory);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+
+#endif
+
+int main() {
+#ifdef EXPRESSION_INSTRUMENTATION
+	std::printf("memory suite needs a build without EXPRESSION_INSTRUMENTATION\n");
+	return 2;
+#else
+	const size_t count = 1000000;
+	std::vector<expression> formulas;
+	formulas.reserve(count);
+
+	long long bytes_before = live_bytes;
+	long long allocations_before = allocations;
+	for (size_t i = 0; i < count; i++)
+		formulas.emplace_back("(x+" + std::to_string(i % 1000) + ")*y-z/2");
+
+	long long heap = live_bytes - bytes_before;
+	report_value("sizeof(expression)", sizeof(expression), "bytes");
+	report_value("heap per instance", (double)heap / count, "bytes");
+	report_value("total per instance", (double)heap / count + sizeof(expression), "bytes");
+	report_value("allocations per construction", (double)(allocations - allocations_before) / count, "allocations");
+	return 0;
+#endif
+}
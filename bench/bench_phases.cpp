@@ -0,0 +1,103 @@
+#include "bench.h"
+#include "expression.h"
+#include "expression_cache.h"
+
+// numbered so common subexpression elimination can't collapse a long formula to a few terms
+static const char* pieces[] = { "(x+%zu.5)*y", "{z/%zu}", "[-w*%zu.75]", "(-(a-b_c))", "pi/%zu.125", "e*(%zu-(-t))" };
+static const char* operations = "+-*/";
+
+size_t count_tokens(const std::string& formula) {
+	expression::compiled program;
+	expression_error failure;
+	size_t tokens = 0;
+
+	program.infix_str = formula;
+	program.scan(failure, tokens);
+	return tokens;
+}
+
+std::string generate_formula(size_t tokens) {
+	char piece[64];
+	size_t piece_tokens[6];
+	for (size_t i = 0; i < 6; i++) {
+		std::snprintf(piece, sizeof(piece), pieces[i], (size_t)1);
+		piece_tokens[i] = count_tokens(piece);
+	}
+
+	std::string formula;
+	size_t count = 0;
+	for (size_t i = 0; count < tokens; i++) {
+		if (i != 0) {
+			formula += operations[i % 4];
+			count++;
+		}
+		std::snprintf(piece, sizeof(piece), pieces[i % 6], i + 1);
+		formula += piece;
+		count += piece_tokens[i % 6];
+	}
+	return formula;
+}
+
+static std::string size_name(size_t tokens) {
+	if (tokens >= 1000000)
+		return std::to_string(tokens / 1000000) + "M tokens";
+	if (tokens >= 1000)
+		return std::to_string(tokens / 1000) + "k tokens";
+	return std::to_string(tokens) + " tokens";
+}
+
+void bench_phases() {
+	expression_cache::instance().set_budget(0);
+
+	for (size_t size : { 5, 50, 500, 5000, 50000, 500000, 1000000 }) {
+		std::string formula = generate_formula(size);
+		std::string suffix = std::string(" ") + size_name(size);
+		size_t tokens = count_tokens(formula);
+
+		expression_error failure;
+		size_t scanned_tokens = 0;
+		expression::compiled scanned;
+		scanned.infix_str = formula;
+		scanned.scan(failure, scanned_tokens);
+
+		double seconds = seconds_per_run([&] {
+			expression::compiled program;
+			program.infix_str = formula;
+			program.scan(failure, scanned_tokens);
+		});
+		report("scan" + suffix, tokens / seconds, "tokens");
+
+		// includes copying the scanned program, which optimize changes in place
+		seconds = seconds_per_run([&] {
+			expression::compiled program(scanned);
+			program.optimize();
+		});
+		report("optimize" + suffix, tokens / seconds, "tokens");
+
+		seconds = seconds_per_run([&] { expression::compiled parsed(formula); });
+		report("parse" + suffix, tokens / seconds, "tokens");
+
+		expression ex(formula, { {"x", 1.5}, {"y", -2}, {"z", 3}, {"w", 0.25}, {"a", 7}, {"b_c", 2}, {"t", 0.5} });
+		seconds = seconds_per_run([&] { ex.calculate(); });
+		report("calculate" + suffix, tokens / seconds, "tokens");
+
+		seconds = seconds_per_run([&] {
+			expression constructed(formula, { {"x", 1.5}, {"y", -2}, {"z", 3}, {"w", 0.25}, {"a", 7}, {"b_c", 2}, {"t", 0.5} });
+			constructed.calculate();
+		});
+		report("construct and calculate" + suffix, tokens / seconds, "tokens");
+
+		seconds = seconds_per_run([&] {
+			expression::evaluate(formula, { {"x", 1.5}, {"y", -2}, {"z", 3}, {"w", 0.25}, {"a", 7}, {"b_c", 2}, {"t", 0.5} });
+		});
+		report("evaluate" + suffix, tokens / seconds, "tokens");
+	}
+
+	expression_cache::instance().set_budget(expression_cache::default_budget);
+	for (size_t size : { 50, 5000 }) {
+		std::string formula = generate_formula(size);
+		expression warm(formula);
+		double seconds = seconds_per_run([&] { expression ex(formula); });
+		report("construct cached " + size_name(size), 1 / seconds, "calls");
+	}
+}
@@ -0,0 +1,43 @@
+#include "bench.h"
+#include "expression_cache.h"
+#include "program_file.h"
+
+#include <cstdio>
+#include <vector>
+
+void bench_program_file() {
+	const size_t count = 100000;
+	const char* path = "bench_programs.bin";
+	std::vector<std::string> formulas;
+
+	for (size_t i = 0; i < count; i++)
+		formulas.push_back("(x+" + std::to_string(i) + ")*y-z/" + std::to_string(i % 7 + 1) + "+[w*" + std::to_string(i % 13) + "]");
+
+	double seconds = seconds_per_run([&] {
+		for (const std::string& formula : formulas)
+			expression::compiled program(formula);
+	});
+	report("parse 100k formulas", count / seconds, "formulas");
+
+	program_file::write(path, formulas);
+	seconds = seconds_per_run([&] { program_file file(path); });
+	report("open 100k program file", 1 / seconds, "opens");
+
+	// a fresh file each run, so every record is checked and materialised
+	seconds = seconds_per_run([&] {
+		program_file file(path);
+		for (const std::string& formula : formulas)
+			file.find(formula);
+	});
+	report("load 100k formulas from program file", count / seconds, "formulas");
+
+	program_file file(path);
+	for (const std::string& formula : formulas)
+		file.find(formula);
+	seconds = seconds_per_run([&] {
+		for (const std::string& formula : formulas)
+			file.find(formula);
+	});
+	report("find 100k loaded formulas in program file", count / seconds, "formulas");
+	std::remove(path);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+// result of expression::calculate_async; can be co_awaited or waited on with get()
+class calculation {
+	struct state {
+		std::mutex mutex;
+		std::condition_variable finished;
+		bool done = false;
+		double value = 0;
+		std::exception_ptr error;
+		std::coroutine_handle<> continuation;
+	};
+
+public:
+	struct promise_type {
+		std::shared_ptr<state> shared = std::make_shared<state>();
+
+		struct final_awaiter {
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+				std::shared_ptr<state> shared = handle.promise().shared;
+				std::coroutine_handle<> continuation;
+				{
+					std::lock_guard<std::mutex> lock(shared->mutex);
+					shared->done = true;
+					continuation = shared->continuation;
+					shared->finished.notify_all();
+				}
+				return continuation ? continuation : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+
+		calculation get_return_object() { return calculation(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		final_awaiter final_suspend() noexcept { return {}; }
+		void return_value(double value) { shared->value = value; }
+		void unhandled_exception() { shared->error = std::current_exception(); }
+	};
+
+private:
+	std::coroutine_handle<promise_type> handle;
+	std::shared_ptr<state> shared;
+
+	explicit calculation(std::coroutine_handle<promise_type> handle) : handle(handle), shared(handle.promise().shared) {
+	}
+
+	void wait() const {
+		std::unique_lock<std::mutex> lock(shared->mutex);
+		shared->finished.wait(lock, [this] { return shared->done; });
+	}
+
+	double result() const {
+		if (shared->error)
+			std::rethrow_exception(shared->error);
+		return shared->value;
+	}
+
+public:
+	calculation(calculation&& other) noexcept : handle(other.handle), shared(std::move(other.shared)) {
+		other.handle = nullptr;
+	}
+	calculation(const calculation&) = delete;
+	calculation& operator=(const calculation&) = delete;
+	calculation& operator=(calculation&&) = delete;
+
+	~calculation() {
+		if (handle) {
+			wait();
+			handle.destroy();
+		}
+	}
+
+	bool is_done() const {
+		std::lock_guard<std::mutex> lock(shared->mutex);
+		return shared->done;
+	}
+
+	// blocks the calling thread until the value is ready
+	double get() const {
+		wait();
+		return result();
+	}
+
+	bool await_ready() const { return is_done(); }
+	bool await_suspend(std::coroutine_handle<> awaiting) {
+		std::lock_guard<std::mutex> lock(shared->mutex);
+		if (shared->done)
+			return false;
+		shared->continuation = awaiting;
+		return true;
+	}
+	double await_resume() const { return result(); }
+};
@@ -1,82 +1,228 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stack>
 #include <map>
 #include <initializer_list>
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <memory>
+
+#include "calculation.h"
+#include "jit.h"
+#include "resolver.h"
+#include "result.h"
+#include "thread_pool.h"
 
 class expression {
-	enum class states_of_waiting {
-		number,
-		number_or_left_bracket_or_symbol,
-		number_or_left_bracket_or_unary_minus_or_symbol,
-		number_or_operation_or_point_or_right_bracket,
-		number_or_operation_or_right_bracket,
-		operation_or_right_bracket,
-		symbol_or_operation_or_right_bracket,
-		success
-	};
+	friend class program_file;
 
-	enum class type_of_literal {
-		operand,
-		right_bracket,
-		left_bracket,
+	enum class class_of_char : unsigned char {
+		other,
+		number,
+		symbol,
+		exponent,
+		point,
 		operation,
+		unary_minus,
+		plus,
+		left_bracket,
+		right_bracket,
+		count
 	};
 
+	static const std::array<class_of_char, 256> classes_of_chars;
+
 	enum class special_signes {
 		point = '.',
 		unary_minus = '-'
 	};
 
-	std::string infix_str;
-	std::string postfix_str;
-	std::vector<std::pair<std::string, type_of_literal>> infix;
-	std::vector<std::pair<std::string, type_of_literal>> postfix;
-
-	const std::vector<char> operations = { '+','-','*','/' };
-	const std::map<char, int> priorities = { {'+',0},{'-',0},{'*',1},{'/',1} };
-	const std::vector<char> left_brackets = { '(','[','{' };
-	const std::vector<char> right_brackets = { ')',']','}' };
-	const std::vector<char> numbers = { '1','2', '3', '4', '5', '6', '7', '8', '9', '0' };
-	const std::vector<char> symbols = { 'q', 'Q', 'w', 'W', 'e', 'E', 'r', 'R', 't', 'T', 'y', 'Y', 'u',
-		'U', 'i', 'I', 'o', 'O', 'p', 'P', 'a', 'A', 's', 'S', 'd', 'D', 'f', 'F', 'g', 'G', 'h', 'H',
-		'j', 'J', 'k', 'K', 'l', 'L', 'z', 'Z', 'x', 'X', 'c', 'C', 'v', 'V', 'b', 'B', 'n', 'N', 'm', 'M', '_' };
-
-	
-	std::map<std::string, double> constants = { {"pi",3.14159265358979323846},
-												{"e", 2.71828182845904523536}
-												};
-	std::map<std::string, double> variables = constants;
-	
-	bool split();
-	bool check_brackets();
-	bool is_in_vector(const std::vector<char>& v, char value);
-	double operate(double first, double second, char operation);
-	void request_variables();
-
-	void to_postfix();
+	enum class opcode : unsigned char {
+		push_literal,
+		push_variable,
+		push_temp,
+		store_temp,
+		negate,
+		add,
+		sub,
+		mul,
+		div
+	};
+
+	struct instruction {
+		opcode code;
+		unsigned int index;
+	};
+
+	static constexpr std::array<std::pair<char, int>, 4> priorities = { { {'+',0},{'-',0},{'*',1},{'/',1} } };
+	static constexpr int unary_minus_priority = 2;
+
+	// a number, name, operation or bracket of an infix, as offset and length into that infix; numbers are
+	// read once when the token is. Trivially copyable, so reading and reordering tokens never allocates
+	struct token {
+		enum kind_of_token : unsigned char {
+			number,
+			name,
+			operation,
+			unary_minus,
+			bracket
+		} kind;
+		// the operation, or the closing bracket that matches an open one
+		char sign;
+		uint32_t length;
+		size_t offset;
+		double value;
+	};
+	static_assert(std::is_trivially_copyable_v<token>);
+
+	static int priority(const token& operation);
+
+	// reads infix in one pass and hands operands and operations to out in postfix order
+	template <typename sink>
+	static bool scan(std::string_view infix, sink& out, expression_error& failure, size_t& tokens);
+
+	// calculates operations as scan hands them over instead of building a program
+	struct one_shot;
+
+	static constexpr std::array<std::pair<const char*, double>, 2> constants = { { {"pi",3.14159265358979323846},
+																					{"e", 2.71828182845904523536} } };
+
+public:
+	struct compiled;
+
+private:
+	std::shared_ptr<const compiled> code;
+	std::vector<double> slot_values;
+	std::vector<bool> bound_slots;
+	size_t unbound_slots = 0;
+
+	void parse(const std::string& str);
+	bool parse(const std::string& str, expression_error& failure);
+	double execute(const double* frame, expression_error& failure) const;
+	// with variables left unbound: whichever of an unbound variable and a division by zero the program
+	// runs into first, the order the postfix interpreter always reported them in
+	expression_error first_error() const;
+	static double operate(double first, double second, opcode operation);
+	static const double* find_constant(std::string_view name);
+	void bind(const std::string& name, double value);
+
+public:
+	struct column {
+		const double* data = nullptr;
+		size_t stride = 1;
+	};
+
+private:
+	static constexpr size_t rows_in_block = 256;
+
+	static constexpr size_t rows_in_chunk = 16 * rows_in_block;
+
+	struct block_workspace {
+		std::vector<double> stack;
+		std::vector<double> temps;
+		std::vector<const double*> inputs;
+		std::vector<double> row;
+	};
+
+	block_workspace make_workspace() const;
+	// each returns true if a row of the block divided by zero, and marks such rows in errors if it is given
+	bool calculate_block(const std::vector<column>& columns, size_t first_row, double* result, size_t count, block_workspace& workspace, row_errors* errors) const;
+	bool calculate_block_interpreted(const std::vector<column>& columns, size_t first_row, double* result, size_t count, block_workspace& workspace, row_errors* errors) const;
+	bool calculate_block_native(const std::vector<column>& columns, size_t first_row, double* result, size_t count, block_workspace& workspace, row_errors* errors) const;
+	expression_error check_columns(const std::vector<column>& columns) const;
 
 public:
 	expression() = default;
 	expression(std::string str);
-	expression(const expression& ex);
+	expression(const expression& ex) = default;
+	expression(expression&& ex) noexcept = default;
 	expression(std::string str, std::initializer_list<std::pair<std::string, double>> list);
 
+	expression& operator=(const expression& ex) = default;
+	expression& operator=(expression&& ex) noexcept = default;
+
 	friend std::istream& operator>>(std::istream& in, expression& ex) {
-		in >> ex.infix_str;
-		if (!ex.split())
-			throw "incorrect input";
-		ex.to_postfix();
-		ex.request_variables();
+		std::string str;
+		in >> str;
+		ex.parse(str);
 		return in;
 	}
 
-	std::string get_infix();
-	std::string get_postfix();
+	std::string get_infix() const;
+	std::string get_postfix() const;
+	std::vector<std::string> get_variables() const;
+	std::vector<std::string> get_unbound_variables() const;
+
+	void resolve(resolver& source);
+	// binds the fetched values when the future is waited on; the expression must outlive it
+	std::future<void> resolve_async(resolver& source);
+
+	// fetches every unbound variable in one resolve_then call and suspends until it completes (the
+	// default resolve_then overlaps the fetches); works on a copy, so neither this expression nor its
+	// bindings change
+	calculation calculate_async(resolver& source) const;
+
+	size_t get_eliminated_nodes() const;
+
+	bool compile_native();
+
+	double calculate() const;
+	// frame holds one value per variable in get_variables() order
+	double calculate(const double* frame) const;
+	void calculate(const std::vector<column>& columns, double* result, size_t count) const;
+	void calculate(std::initializer_list<std::pair<std::string, column>> columns, double* result, size_t count) const;
+	void calculate(const std::vector<column>& columns, double* result, size_t count, thread_pool& pool) const;
+
+	// parses and calculates in one pass without building a program or allocating, for formulas used once.
+	// The resolver is asked for each variable as the scan reaches it; its exceptions are not caught
+	static double evaluate(std::string_view infix, std::initializer_list<std::pair<std::string_view, double>> bindings = {});
+	static double evaluate(std::string_view infix, resolver& source);
+	static result<double> try_evaluate(std::string_view infix, std::initializer_list<std::pair<std::string_view, double>> bindings = {});
+	static result<double> try_evaluate(std::string_view infix, resolver& source);
+
+	// the same as the constructor and calculate, but errors are returned instead of thrown
+	static result<expression> try_parse(const std::string& str);
+	result<double> try_calculate() const;
+	result<double> try_calculate(const double* frame) const;
+	// rows that divide by zero are marked in errors and get what IEEE division gives; the rest of the batch
+	// is still calculated. The result holds the number of marked rows
+	result<size_t> try_calculate(const std::vector<column>& columns, double* result, size_t count, row_errors& errors) const;
+	result<size_t> try_calculate(const std::vector<column>& columns, double* result, size_t count, row_errors& errors, thread_pool& pool) const;
+};
+
+struct expression::compiled {
+	std::string infix_str;
+	std::string postfix_str;
+	std::vector<instruction> program;
+	std::vector<double> literals;
+	std::vector<std::string> slots;
+	size_t stack_depth = 0;
+	size_t temp_count = 0;
+	size_t eliminated_nodes = 0;
+	std::shared_ptr<jit::native_code> native;
+
+	compiled() = default;
+	explicit compiled(const std::string& str);
+	// leaves the program empty and sets failure if str does not parse
+	compiled(const std::string& str, expression_error& failure);
+
+	size_t memory_size() const;
 
-	double calculate();
-};
\ No newline at end of file
+	bool translate(expression_error& failure);
+	// validates brackets, reads tokens and emits the postfix program in one pass over infix_str
+	bool scan(expression_error& failure, size_t& tokens);
+	// where scan hands operands and operations over
+	void push_operand(const token& operand, std::string_view infix);
+	void push_operation(const token& operation);
+	void optimize();
+	void fold_constants();
+	void eliminate_common_subexpressions();
+	size_t max_stack_depth() const;
+};
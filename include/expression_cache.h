@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expression.h"
+#include "program_file.h"
+
+class expression_cache {
+	struct entry {
+		std::shared_ptr<const expression::compiled> program;
+		size_t cost;
+		std::list<const std::string*>::iterator position;
+	};
+
+	struct shard {
+		std::mutex mutex;
+		std::unordered_map<std::string, entry> entries;
+		// most recently used first, points at keys of entries
+		std::list<const std::string*> recent;
+		size_t bytes = 0;
+	};
+
+	std::vector<std::unique_ptr<shard>> shards;
+	std::atomic<size_t> budget;
+	std::atomic<size_t> hits{ 0 };
+	std::atomic<size_t> misses{ 0 };
+	std::atomic<size_t> evictions{ 0 };
+	std::atomic<size_t> loads{ 0 };
+
+	std::mutex files_mutex;
+	std::vector<std::shared_ptr<const program_file>> files;
+	std::atomic<size_t> file_count{ 0 };
+
+	shard& shard_of(const std::string& infix);
+	void evict(shard& target, size_t limit);
+
+public:
+	static constexpr size_t default_budget = 64 << 20;
+	static constexpr size_t default_shards = 16;
+
+	struct statistics {
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+		size_t loads;
+		size_t entries;
+		size_t bytes;
+	};
+
+	explicit expression_cache(size_t memory_budget = default_budget, size_t shard_count = default_shards);
+	expression_cache(const expression_cache&) = delete;
+	expression_cache& operator=(const expression_cache&) = delete;
+
+	static expression_cache& instance();
+
+	std::shared_ptr<const expression::compiled> find(const std::string& infix);
+	void insert(const std::string& infix, std::shared_ptr<const expression::compiled> program);
+
+	// programs missing from memory are looked up in attached files before they are parsed
+	void attach(std::shared_ptr<const program_file> file);
+	// programs already loaded from the file stay cached
+	void detach(const std::shared_ptr<const program_file>& file);
+
+	void set_budget(size_t memory_budget);
+	void clear();
+
+	statistics get_statistics();
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// Per-phase timings and counters, compiled in only with -DEXPRESSION_INSTRUMENTATION
+// (the CMake option of the same name). Each thread records into its own counters;
+// collect() adds up every thread, including threads that have already exited.
+// Instrumented builds replace the global operator new to count allocations per phase.
+namespace instrumentation {
+
+#ifdef EXPRESSION_INSTRUMENTATION
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+enum class phase {
+	scan,
+	optimize,
+	resolve,
+	calculate,
+	calculate_batch,
+	evaluate,
+	count
+};
+
+enum class counter {
+	tokens,
+	postfix_length,
+	stack_depth,
+	rows,
+	count
+};
+
+struct phase_statistics {
+	uint64_t calls = 0;
+	uint64_t nanoseconds = 0;
+	uint64_t allocations = 0;
+};
+
+struct counter_statistics {
+	uint64_t total = 0;
+	uint64_t maximum = 0;
+};
+
+struct snapshot {
+	std::array<phase_statistics, (size_t)phase::count> phases;
+	std::array<counter_statistics, (size_t)counter::count> counters;
+};
+
+const char* name(phase measured);
+const char* name(counter measured);
+
+snapshot collect();
+void reset();
+
+void record(phase measured, uint64_t nanoseconds, uint64_t allocations);
+void add(counter measured, uint64_t value);
+uint64_t allocations_on_this_thread();
+
+class scoped_timer {
+	phase measured;
+	uint64_t first_allocation;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	explicit scoped_timer(phase measured) : measured(measured), first_allocation(allocations_on_this_thread()), start(std::chrono::steady_clock::now()) {
+	}
+	scoped_timer(const scoped_timer&) = delete;
+	scoped_timer& operator=(const scoped_timer&) = delete;
+	~scoped_timer() {
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		record(measured, elapsed.count(), allocations_on_this_thread() - first_allocation);
+	}
+};
+
+}
+
+#define EXPRESSION_CONCATENATE_(first, second) first##second
+#define EXPRESSION_CONCATENATE(first, second) EXPRESSION_CONCATENATE_(first, second)
+
+#ifdef EXPRESSION_INSTRUMENTATION
+#define EXPRESSION_TIME(measured) instrumentation::scoped_timer EXPRESSION_CONCATENATE(phase_timer_, __LINE__)(instrumentation::phase::measured)
+#define EXPRESSION_COUNT(measured, value) instrumentation::add(instrumentation::counter::measured, (value))
+#else
+#define EXPRESSION_TIME(measured) ((void)0)
+#define EXPRESSION_COUNT(measured, value) ((void)0)
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jit {
+
+// temps holds one double per temporary for scalar code and two for batch code
+using scalar_function = double (*)(const double* slots, unsigned int* division_by_zero, double* temps);
+using batch_function = void (*)(const double* const* columns, double* result, size_t pairs, unsigned int* division_by_zero, double* temps);
+
+enum class kind : unsigned char {
+	load_slot,
+	load_literal,
+	load_temp,
+	store_temp,
+	negate,
+	add,
+	sub,
+	mul,
+	div
+};
+
+struct operation {
+	kind code;
+	unsigned int slot;
+	double value;
+};
+
+class native_code {
+	void* memory;
+	size_t size;
+
+public:
+	scalar_function scalar = nullptr;
+	batch_function batch = nullptr;
+
+	native_code(void* memory, size_t size);
+	native_code(const native_code&) = delete;
+	native_code& operator=(const native_code&) = delete;
+	~native_code();
+};
+
+// operand stack depth the generated code can keep in xmm registers
+const size_t max_depth = 13;
+
+bool is_available();
+
+// returns nullptr if the host is not x86-64 Linux or the program is too deep
+std::shared_ptr<native_code> compile(const std::vector<operation>& program);
+
+}
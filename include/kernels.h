@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+namespace kernels {
+
+enum class isa {
+	scalar,
+	sse2,
+	avx2,
+	avx512
+};
+
+struct table {
+	isa set;
+	void (*add)(double* first, const double* second, size_t count);
+	void (*sub)(double* first, const double* second, size_t count);
+	void (*mul)(double* first, const double* second, size_t count);
+	// returns true if any lane of second is zero; all lanes are divided regardless
+	bool (*div)(double* first, const double* second, size_t count);
+	void (*negate)(double* values, size_t count);
+};
+
+bool is_supported(isa set);
+isa best_isa();
+const char* name(isa set);
+
+const table& get(isa set);
+const table& selected();
+void select(isa set);
+
+}
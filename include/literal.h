@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string_view>
+
+namespace literal {
+
+// Reads a whole decimal literal such as "-12.5" or "1.5e-9" without looking at the locale.
+// The result is correctly rounded; false if text is not a literal or does not fit a double.
+bool parse(std::string_view text, double& value);
+
+}
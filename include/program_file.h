@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expression.h"
+
+// Compiled expressions stored in a file that is mapped into memory as is
+// (read into a buffer where mmap is not available).
+// Opening checks the header only. Each record carries its own checksum, which find checks the first
+// time it reaches the record; verify checks the whole file.
+class program_file {
+	// lets tests damage a file the way a bad disk or an attacker could
+	friend class program_file_layout;
+
+	struct header {
+		char magic[8];
+		uint32_t version;
+		uint32_t count;
+		uint64_t buckets;
+		uint64_t size;
+		uint64_t checksum;
+	};
+
+	struct text {
+		uint64_t offset;
+		uint64_t length;
+	};
+
+	struct record {
+		uint64_t hash;
+		text infix;
+		text postfix;
+		uint64_t names;
+		uint64_t program;
+		uint64_t literals;
+		uint32_t name_count;
+		uint32_t program_length;
+		uint32_t literal_count;
+		uint32_t stack_depth;
+		uint32_t temp_count;
+		uint32_t eliminated_nodes;
+		// every section above lies in body, which the checksum covers together with the fields above
+		text body;
+		uint64_t checksum;
+	};
+
+	const unsigned char* data = nullptr;
+	size_t length = 0;
+	std::vector<unsigned char> contents;
+
+	// programs already materialised, by record index, so a repeated find doesn't allocate
+	mutable std::mutex loaded_mutex;
+	mutable std::unordered_map<uint32_t, std::shared_ptr<const expression::compiled>> loaded;
+
+	const header& get_header() const;
+	const record* records() const;
+	const uint32_t* buckets() const;
+	bool in_bounds(uint64_t offset, uint64_t size) const;
+
+	static uint64_t hash(const char* text, size_t length);
+	static uint64_t checksum(const unsigned char* data, size_t length);
+	static uint64_t record_checksum(const unsigned char* data, const record& r);
+	std::shared_ptr<const expression::compiled> load(const record& r, const std::string& infix) const;
+
+public:
+	static constexpr uint32_t version = 2;
+
+	explicit program_file(const std::string& path);
+	program_file(const program_file&) = delete;
+	program_file& operator=(const program_file&) = delete;
+	~program_file();
+
+	size_t size() const;
+
+	// reads the whole file; throws if its checksum doesn't match
+	void verify() const;
+
+	// nullptr if the file has no program for this infix
+	std::shared_ptr<const expression::compiled> find(const std::string& infix) const;
+
+	// compiles every infix that parses and writes them to path; returns how many were written
+	static size_t write(const std::string& path, const std::vector<std::string>& infixes);
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// supplies values for variables an expression was not given
+class resolver {
+public:
+	virtual ~resolver() = default;
+
+	virtual double resolve(const std::string& name) = 0;
+
+	// values has one element per name; calls resolve for each name by default
+	virtual void resolve(const std::vector<std::string>& names, double* values);
+
+	// runs the batched resolve on another thread by default; the resolver must outlive the future
+	virtual std::future<std::vector<double>> resolve_async(std::vector<std::string> names);
+
+	// calls done once, from any thread, with the values or the error. By default every name is fetched
+	// on its own thread with the single-name resolve, so those fetches overlap; resolve has to be safe
+	// to call from several threads at once, and the resolver must outlive the fetches
+	virtual void resolve_then(std::vector<std::string> names, std::function<void(std::vector<double> values, std::exception_ptr error)> done);
+};
+
+// asks for every value on a console, the way operator>> used to
+class console_resolver : public resolver {
+	std::istream& in;
+	std::ostream& out;
+
+public:
+	explicit console_resolver(std::istream& in = std::cin, std::ostream& out = std::cout);
+
+	double resolve(const std::string& name) override;
+	using resolver::resolve;
+
+	// asks inline, one prompt after another
+	void resolve_then(std::vector<std::string> names, std::function<void(std::vector<double> values, std::exception_ptr error)> done) override;
+};
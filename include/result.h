@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+enum class error_code {
+	none,
+	incorrect_input,
+	number_out_of_range,
+	division_by_zero,
+	variable_was_not_input,
+	expression_is_empty,
+	wrong_number_of_columns,
+	constant_was_bound
+};
+
+struct expression_error {
+	error_code code = error_code::none;
+	// offset in the infix where parsing stopped; 0 for errors found while calculating
+	size_t position = 0;
+
+	// the text the throwing functions use for the same error
+	const char* message() const;
+};
+
+// either a value or the error that prevented it, for callers that can't afford exceptions
+template <typename T>
+class result {
+	T stored{};
+	expression_error failure;
+
+public:
+	result(T value) : stored(std::move(value)) {
+	}
+	result(expression_error failure) : failure(failure) {
+	}
+
+	bool has_value() const {
+		return failure.code == error_code::none;
+	}
+	explicit operator bool() const {
+		return has_value();
+	}
+
+	const expression_error& error() const {
+		return failure;
+	}
+
+	// throws the message of the error if there is no value
+	T& value() & {
+		if (!has_value())
+			throw failure.message();
+		return stored;
+	}
+	const T& value() const& {
+		if (!has_value())
+			throw failure.message();
+		return stored;
+	}
+	T&& value() && {
+		if (!has_value())
+			throw failure.message();
+		return std::move(stored);
+	}
+	T value_or(T otherwise) const {
+		return has_value() ? stored : otherwise;
+	}
+
+	T& operator*() {
+		return stored;
+	}
+	const T& operator*() const {
+		return stored;
+	}
+	T* operator->() {
+		return &stored;
+	}
+	const T* operator->() const {
+		return &stored;
+	}
+};
+
+// one bit per row of a batch, set for the rows that divided by zero
+class row_errors {
+	std::vector<uint64_t> words;
+	size_t rows = 0;
+
+public:
+	void reset(size_t count) {
+		words.assign((count + 63) / 64, 0);
+		rows = count;
+	}
+	// rows in different words may be set from different threads
+	void set(size_t row) {
+		words[row / 64] |= uint64_t(1) << (row % 64);
+	}
+	bool test(size_t row) const {
+		return (words[row / 64] >> (row % 64)) & 1;
+	}
+
+	size_t size() const {
+		return rows;
+	}
+	size_t count() const;
+	bool any() const;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+	struct queue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::vector<std::unique_ptr<queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic<size_t> pending{ 0 };
+	std::atomic<size_t> next_queue{ 0 };
+	bool stopping = false;
+
+	static size_t configured_size;
+	static std::atomic<bool> instance_created;
+
+	static size_t instance_size();
+
+	void push(std::function<void()> task);
+	bool try_run(size_t home);
+	void work(size_t home);
+
+public:
+	explicit thread_pool(size_t threads);
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+	~thread_pool();
+
+	static void configure(size_t threads);
+	static thread_pool& instance();
+
+	size_t size() const;
+
+	void parallel_for(size_t count, size_t chunk, const std::function<void(size_t begin, size_t end)>& body);
+};
@@ -0,0 +1,243 @@
+// Evaluates a file of expressions, one per line, on every core.
+//
+//   eval_expression <expressions> [bindings] [programs]
+//
+// The bindings file holds "name = value" lines for the variables the expressions use.
+// A programs file written by prebuild_programs saves parsing the expressions it contains.
+// Results are written to stdout in input order, progress and statistics go to stderr.
+
+#include "expression.h"
+#include "expression_cache.h"
+#include "instrumentation.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class bindings_resolver : public resolver {
+	std::map<std::string, double> values;
+
+public:
+	explicit bindings_resolver(const char* path) {
+		std::ifstream in(path);
+		std::string name, sign;
+		double value;
+
+		if (!in)
+			throw "can't open bindings file";
+		while (in >> name >> sign >> value) {
+			if (sign != "=")
+				throw "bindings must look like name = value";
+			values[name] = value;
+		}
+		if (!in.eof())
+			throw "bindings must look like name = value";
+	}
+	bindings_resolver() = default;
+
+	double resolve(const std::string& name) override {
+		auto found = values.find(name);
+		if (found == values.end())
+			throw "variable was not input";
+		return found->second;
+	}
+};
+
+class mapped_file {
+	const char* data = nullptr;
+	size_t length = 0;
+
+public:
+	explicit mapped_file(const char* path) {
+		int descriptor = open(path, O_RDONLY);
+		struct stat info;
+
+		if (descriptor < 0 || fstat(descriptor, &info) != 0)
+			throw "can't open expressions file";
+		length = info.st_size;
+		if (length != 0) {
+			void* memory = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (memory == MAP_FAILED) {
+				close(descriptor);
+				throw "can't map expressions file";
+			}
+			madvise(memory, length, MADV_SEQUENTIAL);
+			data = static_cast<const char*>(memory);
+		}
+		close(descriptor);
+	}
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	~mapped_file() {
+		if (data != nullptr)
+			munmap(const_cast<char*>(data), length);
+	}
+
+	std::string_view text() const {
+		return std::string_view(data, length);
+	}
+};
+
+struct piece {
+	size_t begin;
+	size_t end;
+	std::string output;
+	size_t lines = 0;
+	size_t errors = 0;
+};
+
+// blank lines are echoed as blank and not counted
+static std::string evaluate(std::string_view line, resolver& source, bool one_shot, piece& part) {
+	char buffer[32];
+
+	if (!line.empty() && line.back() == '\r')
+		line.remove_suffix(1);
+	if (line.empty())
+		return std::string();
+	part.lines++;
+
+	// every line is used once, so without prebuilt programs it is calculated while it is parsed
+	if (one_shot) {
+		result<double> value = 0.0;
+		try {
+			value = expression::try_evaluate(line, source);
+		}
+		catch (const char* error) {
+			part.errors++;
+			return std::string("error: ") + error;
+		}
+		if (!value) {
+			part.errors++;
+			if (value.error().code == error_code::incorrect_input || value.error().code == error_code::number_out_of_range) {
+				std::snprintf(buffer, sizeof(buffer), " at %zu", value.error().position);
+				return std::string("error: ") + value.error().message() + buffer;
+			}
+			return std::string("error: ") + value.error().message();
+		}
+		std::snprintf(buffer, sizeof(buffer), "%.17g", *value);
+		return buffer;
+	}
+
+	// bad rows are common in real input, so parsing and calculating report errors without throwing
+	result<expression> parsed = expression::try_parse(std::string(line));
+	if (!parsed) {
+		part.errors++;
+		std::snprintf(buffer, sizeof(buffer), " at %zu", parsed.error().position);
+		return std::string("error: ") + parsed.error().message() + buffer;
+	}
+
+	try {
+		parsed->resolve(source);
+	}
+	catch (const char* error) {
+		part.errors++;
+		return std::string("error: ") + error;
+	}
+
+	result<double> value = parsed->try_calculate();
+	if (!value) {
+		part.errors++;
+		return std::string("error: ") + value.error().message();
+	}
+	std::snprintf(buffer, sizeof(buffer), "%.17g", *value);
+	return buffer;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2 || argc > 4) {
+		std::fprintf(stderr, "usage: %s <expressions> [bindings] [programs]\n", argv[0]);
+		return 2;
+	}
+
+	try {
+		auto start = std::chrono::steady_clock::now();
+		mapped_file input(argv[1]);
+		bindings_resolver source = argc >= 3 ? bindings_resolver(argv[2]) : bindings_resolver();
+		if (argc == 4)
+			expression_cache::instance().attach(std::make_shared<const program_file>(argv[3]));
+		std::string_view text = input.text();
+		thread_pool& pool = thread_pool::instance();
+
+		// cut the file into pieces that end on line boundaries
+		const size_t piece_size = 1 << 20;
+		std::vector<piece> pieces;
+		for (size_t begin = 0; begin < text.size();) {
+			size_t end = std::min(begin + piece_size, text.size());
+			size_t newline = text.find('\n', end == text.size() ? end : end - 1);
+			end = newline == std::string_view::npos ? text.size() : newline + 1;
+			pieces.push_back({ begin, end, std::string(), 0, 0 });
+			begin = end;
+		}
+
+		std::atomic<size_t> done_bytes{ 0 };
+		std::atomic<bool> finished{ !isatty(STDERR_FILENO) };
+		std::thread progress([&] {
+			while (!finished) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				if (!finished)
+					std::fprintf(stderr, "\r%5.1f%%", text.empty() ? 100.0 : 100.0 * done_bytes / text.size());
+			}
+		});
+
+		try {
+			pool.parallel_for(pieces.size(), 1, [&](size_t first, size_t last) {
+				for (size_t i = first; i < last; i++) {
+					piece& part = pieces[i];
+					std::string_view lines = text.substr(part.begin, part.end - part.begin);
+
+					while (!lines.empty()) {
+						size_t newline = lines.find('\n');
+						std::string_view line = lines.substr(0, newline);
+						part.output += evaluate(line, source, argc < 4, part);
+						part.output += '\n';
+						lines.remove_prefix(newline == std::string_view::npos ? lines.size() : newline + 1);
+					}
+					done_bytes += part.end - part.begin;
+				}
+			});
+		}
+		catch (...) {
+			finished = true;
+			progress.join();
+			throw;
+		}
+		finished = true;
+		progress.join();
+
+		size_t lines = 0;
+		size_t errors = 0;
+		for (const piece& part : pieces) {
+			std::fwrite(part.output.data(), 1, part.output.size(), stdout);
+			lines += part.lines;
+			errors += part.errors;
+		}
+		std::fflush(stdout);
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::fprintf(stderr, "\r%zu expressions, %zu errors, %.3f s, %.0f expressions/s, %.1f MB/s on %zu threads\n",
+			lines, errors, seconds, lines / seconds, text.size() / seconds / 1e6, pool.size());
+		if (instrumentation::enabled) {
+			instrumentation::snapshot taken = instrumentation::collect();
+			for (size_t i = 0; i < taken.phases.size(); i++) {
+				const auto& statistics = taken.phases[i];
+				std::fprintf(stderr, "%-16s %12llu calls %12.3f ms %12llu allocations\n", instrumentation::name((instrumentation::phase)i),
+					(unsigned long long)statistics.calls, statistics.nanoseconds / 1e6, (unsigned long long)statistics.allocations);
+			}
+		}
+		return errors == 0 ? 0 : 1;
+	}
+	catch (const char* error) {
+		std::fprintf(stderr, "%s\n", error);
+		return 2;
+	}
+}
@@ -0,0 +1,42 @@
+// Compiles a file of expressions, one per line, into a program file that
+// expression_cache::attach can load at startup without parsing.
+//
+//   prebuild_programs <expressions> <programs>
+
+#include "program_file.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		std::fprintf(stderr, "usage: %s <expressions> <programs>\n", argv[0]);
+		return 2;
+	}
+
+	try {
+		auto start = std::chrono::steady_clock::now();
+		std::ifstream in(argv[1]);
+		std::vector<std::string> infixes;
+		std::string line;
+
+		if (!in)
+			throw "can't open expressions file";
+		while (std::getline(in, line)) {
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (!line.empty())
+				infixes.push_back(line);
+		}
+
+		size_t written = program_file::write(argv[2], infixes);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::fprintf(stderr, "%zu programs from %zu lines in %.3f s\n", written, infixes.size(), seconds);
+		return 0;
+	}
+	catch (const char* error) {
+		std::fprintf(stderr, "%s\n", error);
+		return 2;
+	}
+}
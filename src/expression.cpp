@@ -1,361 +1,1169 @@
 #include "expression.h"
+#include "expression_cache.h"
+#include "instrumentation.h"
+#include "kernels.h"
+#include "literal.h"
 
-expression::expression(std::string str) : infix_str(str) {
-	if (!split()) 
-		throw "incorrect input";
-	to_postfix();
+namespace {
+
+// a stack that stays inside the object until it outgrows local_size elements
+template <typename T, size_t local_size>
+class small_stack {
+	T local[local_size];
+	std::vector<T> allocated;
+	T* data = local;
+	size_t capacity = local_size;
+	size_t count = 0;
+
+public:
+	small_stack() = default;
+	small_stack(const small_stack&) = delete;
+	small_stack& operator=(const small_stack&) = delete;
+
+	void push(const T& value) {
+		if (count == capacity) {
+			std::vector<T> bigger(capacity * 2);
+			std::copy(data, data + count, bigger.begin());
+			allocated = std::move(bigger);
+			data = allocated.data();
+			capacity *= 2;
+		}
+		data[count++] = value;
+	}
+	void pop() {
+		count--;
+	}
+	T& top() {
+		return data[count - 1];
+	}
+	T& operator[](size_t index) {
+		return data[index];
+	}
+	bool empty() const {
+		return count == 0;
+	}
+	size_t size() const {
+		return count;
+	}
+};
 
 }
-expression::expression(const expression& ex) : infix_str(ex.infix_str),postfix_str(ex.postfix_str), infix(ex.infix), postfix(ex.postfix) {}
+
+expression::expression(std::string str) {
+	parse(str);
+}
 expression::expression(std::string str, std::initializer_list<std::pair<std::string, double>> list) : expression(str) {
 
-	for (auto i : list) {
-		if (variables.find(i.first) != variables.end()) 
-			throw "you can't change constants";
-		
-		variables.insert(i);
+	for (auto i : list)
+		bind(i.first, i.second);
+}
+
+void expression::parse(const std::string& str) {
+	expression_error failure;
+
+	if (!parse(str, failure))
+		throw failure.message();
+}
+
+bool expression::parse(const std::string& str, expression_error& failure) {
+	expression_cache& cache = expression_cache::instance();
+
+	code = cache.find(str);
+	if (!code) {
+		auto program = std::make_shared<const compiled>(str, failure);
+		if (failure.code != error_code::none) {
+			slot_values.clear();
+			bound_slots.clear();
+			unbound_slots = 0;
+			return false;
+		}
+		code = std::move(program);
+		cache.insert(str, code);
+	}
+	slot_values.assign(code->slots.size(), 0);
+	bound_slots.assign(code->slots.size(), false);
+	unbound_slots = code->slots.size();
+	return true;
+}
+
+result<expression> expression::try_parse(const std::string& str) {
+	expression ex;
+	expression_error failure;
+
+	if (!ex.parse(str, failure))
+		return failure;
+	return ex;
+}
+
+expression::compiled::compiled(const std::string& str) : infix_str(str) {
+	expression_error failure;
+
+	if (!translate(failure))
+		throw failure.message();
+}
+
+expression::compiled::compiled(const std::string& str, expression_error& failure) : infix_str(str) {
+	translate(failure);
+}
+
+bool expression::compiled::translate(expression_error& failure) {
+	size_t tokens = 0;
+
+	if (!scan(failure, tokens)) {
+		postfix_str.clear();
+		program.clear();
+		literals.clear();
+		slots.clear();
+		return false;
+	}
+	EXPRESSION_COUNT(tokens, tokens);
+	EXPRESSION_COUNT(postfix_length, program.size());
+	optimize();
+	EXPRESSION_COUNT(stack_depth, stack_depth);
+	return true;
+}
+
+size_t expression::compiled::memory_size() const {
+	size_t size = sizeof(compiled) + infix_str.capacity() + postfix_str.capacity();
+
+	size += program.capacity() * sizeof(instruction) + literals.capacity() * sizeof(double);
+	for (const std::string& slot : slots)
+		size += sizeof(std::string) + slot.capacity();
+	return size;
+}
+
+const double* expression::find_constant(std::string_view name) {
+	for (const auto& constant : constants) {
+		if (name == constant.first)
+			return &constant.second;
 	}
+	return nullptr;
 }
 
-double expression::operate(double first, double second, char operation) {
+void expression::bind(const std::string& name, double value) {
+	if (find_constant(name) != nullptr)
+		throw "you can't change constants";
+
+	size_t slot = std::find(code->slots.begin(), code->slots.end(), name) - code->slots.begin();
+	if (slot == code->slots.size())
+		return;
+	if (bound_slots[slot])
+		throw "variable was already input";
+
+	slot_values[slot] = value;
+	bound_slots[slot] = true;
+	unbound_slots--;
+}
+
+double expression::operate(double first, double second, opcode operation) {
 	switch (operation) {
-	case '+':
+	case opcode::add:
 		return first + second;
-	case '-':
+	case opcode::sub:
 		return first - second;
-	case '*':
+	case opcode::mul:
 		return first * second;
-	case '/':
-		if (second == 0)
-			throw "division by zero";
+	case opcode::div:
 		return first / second;
+	default:
+		return 0;
 	}
-	return 0;
 }
 
-std::string expression::get_infix() { 
-	return infix_str; 
+std::string expression::get_infix() const { 
+	return code ? code->infix_str : std::string(); 
+}
+std::string expression::get_postfix() const {
+	return code ? code->postfix_str : std::string();
+}
+std::vector<std::string> expression::get_variables() const {
+	return code ? code->slots : std::vector<std::string>();
 }
-std::string expression::get_postfix() {
-	return postfix_str;
+size_t expression::get_eliminated_nodes() const {
+	return code ? code->eliminated_nodes : 0;
 }
 
 
-bool expression::is_in_vector(const std::vector<char>& v, char value) {
-	return std::find(v.begin(), v.end(), value) != v.end();
+constexpr std::array<expression::class_of_char, 256> expression::classes_of_chars = [] {
+	std::array<class_of_char, 256> table{};
+
+	for (char c = '0'; c <= '9'; c++)
+		table[(unsigned char)c] = class_of_char::number;
+	for (char c = 'a'; c <= 'z'; c++)
+		table[(unsigned char)c] = class_of_char::symbol;
+	for (char c = 'A'; c <= 'Z'; c++)
+		table[(unsigned char)c] = class_of_char::symbol;
+	table['_'] = class_of_char::symbol;
+	table['e'] = table['E'] = class_of_char::exponent;
+	table[(unsigned char)special_signes::point] = class_of_char::point;
+	table['+'] = class_of_char::plus;
+	table['*'] = class_of_char::operation;
+	table['/'] = class_of_char::operation;
+	table[(unsigned char)special_signes::unary_minus] = class_of_char::unary_minus;
+	table['('] = table['['] = table['{'] = class_of_char::left_bracket;
+	table[')'] = table[']'] = table['}'] = class_of_char::right_bracket;
+
+	return table;
+}();
+
+double expression::calculate() const {
+	if (unbound_slots != 0)
+		throw first_error().message();
+	return calculate(slot_values.data());
 }
 
-bool expression::check_brackets() {
-	std::stack<char> st;
-	std::string left_brackets = "([{";
-	std::string right_brackets = ")]}";
+double expression::calculate(const double* frame) const {
+	expression_error failure;
+	double value = execute(frame, failure);
 
-	for (char element : infix_str) {
-		if (left_brackets.find(element) != -1 || right_brackets.find(element) != -1) {
-			if (left_brackets.find(element) != -1)
-				st.push(right_brackets[left_brackets.find(element)]);
-			else if (!st.empty() && st.top() == element)
-				st.pop();
-			else
-				return false;
+	if (failure.code != error_code::none)
+		throw failure.message();
+	return value;
+}
+
+result<double> expression::try_calculate() const {
+	if (unbound_slots != 0)
+		return first_error();
+	return try_calculate(slot_values.data());
+}
+
+result<double> expression::try_calculate(const double* frame) const {
+	expression_error failure;
+	double value = execute(frame, failure);
+
+	if (failure.code != error_code::none)
+		return failure;
+	return value;
+}
+
+double expression::execute(const double* frame, expression_error& failure) const {
+	EXPRESSION_TIME(calculate);
+	if (!code) {
+		failure.code = error_code::expression_is_empty;
+		return 0;
+	}
+	if (code->program.size() == 1 && code->program[0].code == opcode::push_literal)
+		return code->literals[code->program[0].index];
+
+	const size_t local_size = 64;
+	double local[local_size];
+	std::vector<double> allocated;
+	double* stack = local;
+
+	if (code->stack_depth + code->temp_count > local_size) {
+		allocated.resize(code->stack_depth + code->temp_count);
+		stack = allocated.data();
+	}
+	double* temps = stack + code->stack_depth;
+
+	if (code->native) {
+		unsigned int division_by_zero = 0;
+		double result = code->native->scalar(frame, &division_by_zero, temps);
+		if (division_by_zero)
+			failure.code = error_code::division_by_zero;
+		return result;
+	}
+
+	size_t depth = 0;
+
+	for (const instruction& i : code->program) {
+		switch (i.code) {
+		case opcode::push_literal:
+			stack[depth++] = code->literals[i.index];
+			break;
+		case opcode::push_variable:
+			stack[depth++] = frame[i.index];
+			break;
+		case opcode::push_temp:
+			stack[depth++] = temps[i.index];
+			break;
+		case opcode::store_temp:
+			temps[i.index] = stack[depth - 1];
+			break;
+		case opcode::negate:
+			stack[depth - 1] = -stack[depth - 1];
+			break;
+		case opcode::div:
+			depth--;
+			if (stack[depth] == 0) {
+				failure.code = error_code::division_by_zero;
+				return 0;
+			}
+			stack[depth - 1] /= stack[depth];
+			break;
+		default:
+			depth--;
+			stack[depth - 1] = operate(stack[depth - 1], stack[depth], i.code);
+			break;
+		}
+	}
+
+	return stack[0];
+}
+
+expression_error expression::first_error() const {
+	std::vector<double> stack(code->stack_depth);
+	std::vector<double> temps(code->temp_count);
+	size_t depth = 0;
+
+	for (const instruction& i : code->program) {
+		switch (i.code) {
+		case opcode::push_literal:
+			stack[depth++] = code->literals[i.index];
+			break;
+		case opcode::push_variable:
+			if (!bound_slots[i.index])
+				return { error_code::variable_was_not_input };
+			stack[depth++] = slot_values[i.index];
+			break;
+		case opcode::push_temp:
+			stack[depth++] = temps[i.index];
+			break;
+		case opcode::store_temp:
+			temps[i.index] = stack[depth - 1];
+			break;
+		case opcode::negate:
+			stack[depth - 1] = -stack[depth - 1];
+			break;
+		default:
+			depth--;
+			if (i.code == opcode::div && stack[depth] == 0)
+				return { error_code::division_by_zero };
+			stack[depth - 1] = operate(stack[depth - 1], stack[depth], i.code);
+			break;
 		}
 	}
-	return st.empty();
+	return { error_code::variable_was_not_input };
 }
 
-bool expression::split() {
-	states_of_waiting state = states_of_waiting::number_or_left_bracket_or_unary_minus_or_symbol;
-	std::vector<std::pair<std::string, type_of_literal>> tmp_split;
+expression_error expression::check_columns(const std::vector<column>& columns) const {
+	if (!code)
+		return { error_code::expression_is_empty };
+	if (columns.size() != code->slots.size())
+		return { error_code::wrong_number_of_columns };
+	for (size_t i = 0; i < code->slots.size(); i++) {
+		if (columns[i].data == nullptr && !bound_slots[i])
+			return { error_code::variable_was_not_input };
+	}
+	return {};
+}
 
-	bool unaryMinusIsPreviousLiteral = false;
+void expression::calculate(const std::vector<column>& columns, double* result, size_t count) const {
+	EXPRESSION_TIME(calculate_batch);
+	EXPRESSION_COUNT(rows, count);
+	expression_error failure = check_columns(columns);
+	if (failure.code != error_code::none)
+		throw failure.message();
 
-	size_t start = 0;
+	block_workspace workspace = make_workspace();
 
-	if (!check_brackets()) {
-		return false;
+	for (size_t first_row = 0; first_row < count; first_row += rows_in_block) {
+		if (calculate_block(columns, first_row, result + first_row, std::min(rows_in_block, count - first_row), workspace, nullptr))
+			throw "division by zero";
 	}
+}
 
-	for (size_t i = 0; i < infix_str.size(); i++) {
-		switch (state) {
+void expression::calculate(std::initializer_list<std::pair<std::string, column>> columns, double* result, size_t count) const {
+	if (!code)
+		throw "expression is empty";
 
-		case states_of_waiting::symbol_or_operation_or_right_bracket:
-			if(is_in_vector(symbols, infix_str[i]) || is_in_vector(operations, infix_str[i])||is_in_vector(right_brackets,infix_str[i])){
-				if (is_in_vector(symbols, infix_str[i])) {
-					if (i == infix_str.size() - 1) {
-						state = states_of_waiting::success;
-					}
-				}
-				if (is_in_vector(operations, infix_str[i])) {
-					state = states_of_waiting::number_or_left_bracket_or_symbol;
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(start, i - start), type_of_literal::operand));
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i, 1), type_of_literal::operation));
-					start = i + 1;
-				}
-				if (is_in_vector(right_brackets, infix_str[i])) {
-					state = states_of_waiting::operation_or_right_bracket;
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(start, i - start), type_of_literal::operand));
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i, 1), type_of_literal::right_bracket));
-					if (i == infix_str.size() - 1) {
-						state = states_of_waiting::success;
-					}
-				}
+	std::vector<column> by_slot(code->slots.size());
+
+	for (const auto& i : columns) {
+		if (find_constant(i.first) != nullptr)
+			throw "you can't change constants";
+
+		auto slot = std::find(code->slots.begin(), code->slots.end(), i.first);
+		if (slot != code->slots.end())
+			by_slot[slot - code->slots.begin()] = i.second;
+	}
+	calculate(by_slot, result, count);
+}
+
+void expression::calculate(const std::vector<column>& columns, double* result, size_t count, thread_pool& pool) const {
+	EXPRESSION_TIME(calculate_batch);
+	EXPRESSION_COUNT(rows, count);
+	expression_error failure = check_columns(columns);
+	if (failure.code != error_code::none)
+		throw failure.message();
+
+	pool.parallel_for(count, rows_in_chunk, [&](size_t begin, size_t end) {
+		block_workspace workspace = make_workspace();
+
+		for (size_t first_row = begin; first_row < end; first_row += rows_in_block) {
+			if (calculate_block(columns, first_row, result + first_row, std::min(rows_in_block, end - first_row), workspace, nullptr))
+				throw "division by zero";
+		}
+	});
+}
+
+result<size_t> expression::try_calculate(const std::vector<column>& columns, double* result, size_t count, row_errors& errors) const {
+	EXPRESSION_TIME(calculate_batch);
+	EXPRESSION_COUNT(rows, count);
+	expression_error failure = check_columns(columns);
+	if (failure.code != error_code::none)
+		return failure;
+
+	block_workspace workspace = make_workspace();
+	errors.reset(count);
+
+	for (size_t first_row = 0; first_row < count; first_row += rows_in_block)
+		calculate_block(columns, first_row, result + first_row, std::min(rows_in_block, count - first_row), workspace, &errors);
+	return errors.count();
+}
+
+result<size_t> expression::try_calculate(const std::vector<column>& columns, double* result, size_t count, row_errors& errors, thread_pool& pool) const {
+	EXPRESSION_TIME(calculate_batch);
+	EXPRESSION_COUNT(rows, count);
+	expression_error failure = check_columns(columns);
+	if (failure.code != error_code::none)
+		return failure;
+
+	errors.reset(count);
+	// chunks are whole blocks, so no two threads set bits in the same word
+	pool.parallel_for(count, rows_in_chunk, [&](size_t begin, size_t end) {
+		block_workspace workspace = make_workspace();
+
+		for (size_t first_row = begin; first_row < end; first_row += rows_in_block)
+			calculate_block(columns, first_row, result + first_row, std::min(rows_in_block, end - first_row), workspace, &errors);
+	});
+	return errors.count();
+}
+
+expression::block_workspace expression::make_workspace() const {
+	block_workspace workspace;
+
+	workspace.stack.resize(std::max(code->stack_depth, code->slots.size()) * rows_in_block);
+	workspace.temps.resize(code->temp_count * rows_in_block);
+	workspace.inputs.resize(code->slots.size());
+	workspace.row.resize(code->slots.size());
+	return workspace;
+}
+
+bool expression::calculate_block_native(const std::vector<column>& columns, size_t first_row, double* result, size_t count, block_workspace& workspace, row_errors* errors) const {
+	for (size_t slot = 0; slot < code->slots.size(); slot++) {
+		const column& source = columns[slot];
+		double* buffer = workspace.stack.data() + slot * rows_in_block;
+
+		if (source.data == nullptr) {
+			std::fill(buffer, buffer + count, slot_values[slot]);
+			workspace.inputs[slot] = buffer;
+		}
+		else if (source.stride == 1) {
+			workspace.inputs[slot] = source.data + first_row;
+		}
+		else {
+			const double* data = source.data + first_row * source.stride;
+			for (size_t row = 0; row < count; row++)
+				buffer[row] = data[row * source.stride];
+			workspace.inputs[slot] = buffer;
+		}
+	}
+
+	unsigned int division_by_zero = 0;
+	code->native->batch(workspace.inputs.data(), result, count / 2, &division_by_zero, workspace.temps.data());
+	if (count % 2 != 0) {
+		unsigned int last_division_by_zero = 0;
+		for (size_t slot = 0; slot < code->slots.size(); slot++)
+			workspace.row[slot] = workspace.inputs[slot][count - 1];
+		result[count - 1] = code->native->scalar(workspace.row.data(), &last_division_by_zero, workspace.temps.data());
+		division_by_zero |= last_division_by_zero;
+	}
+	// native code only knows that some row divided by zero; the interpreter finds which
+	if (division_by_zero && errors != nullptr)
+		return calculate_block_interpreted(columns, first_row, result, count, workspace, errors);
+	return division_by_zero != 0;
+}
+
+bool expression::calculate_block(const std::vector<column>& columns, size_t first_row, double* result, size_t count, block_workspace& workspace, row_errors* errors) const {
+	if (code->native)
+		return calculate_block_native(columns, first_row, result, count, workspace, errors);
+	return calculate_block_interpreted(columns, first_row, result, count, workspace, errors);
+}
+
+bool expression::calculate_block_interpreted(const std::vector<column>& columns, size_t first_row, double* result, size_t count, block_workspace& workspace, row_errors* errors) const {
+	bool division_by_zero = false;
+	const kernels::table& kernel = kernels::selected();
+	double* block_stack = workspace.stack.data();
+	double* top = block_stack - rows_in_block;
+
+	for (const instruction& i : code->program) {
+		switch (i.code) {
+		case opcode::push_literal:
+			top += rows_in_block;
+			std::fill(top, top + count, code->literals[i.index]);
+			break;
+		case opcode::push_variable: {
+			const column& source = columns[i.index];
+			top += rows_in_block;
+			if (source.data == nullptr) {
+				std::fill(top, top + count, slot_values[i.index]);
+				break;
 			}
-			else {
-				return false;
+			const double* data = source.data + first_row * source.stride;
+			if (source.stride == 1) {
+				std::copy(data, data + count, top);
+				break;
 			}
+			for (size_t row = 0; row < count; row++)
+				top[row] = data[row * source.stride];
 			break;
-			
-
-		case states_of_waiting::number_or_left_bracket_or_unary_minus_or_symbol:
-			unaryMinusIsPreviousLiteral = false;
-			if (is_in_vector(numbers, infix_str[i]) || is_in_vector(left_brackets, infix_str[i]) || infix_str[i] == (char)special_signes::unary_minus|| is_in_vector(symbols, infix_str[i])) {
-				if (is_in_vector(symbols, infix_str[i])) {
-					state = states_of_waiting::symbol_or_operation_or_right_bracket;
-				}
-				else if (is_in_vector(numbers, infix_str[i])) {
-					state = states_of_waiting::number_or_operation_or_point_or_right_bracket;
-				}
-				else if (is_in_vector(left_brackets, infix_str[i])) {
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i,1),type_of_literal::left_bracket));
-					start = i + 1;
-				}
-				else if (infix_str[i] == (char)special_signes::unary_minus) {
-					state = states_of_waiting::number_or_left_bracket_or_symbol;
-					start = i;
-					unaryMinusIsPreviousLiteral = true;
-				}
-				if (i == infix_str.size() - 1 && infix_str[i] != (char)special_signes::unary_minus) {
-					state = states_of_waiting::success;
+		}
+		case opcode::push_temp: {
+			const double* temp = workspace.temps.data() + i.index * rows_in_block;
+			top += rows_in_block;
+			std::copy(temp, temp + count, top);
+			break;
+		}
+		case opcode::store_temp:
+			std::copy(top, top + count, workspace.temps.data() + i.index * rows_in_block);
+			break;
+		case opcode::negate:
+			kernel.negate(top, count);
+			break;
+		case opcode::add:
+			top -= rows_in_block;
+			kernel.add(top, top + rows_in_block, count);
+			break;
+		case opcode::sub:
+			top -= rows_in_block;
+			kernel.sub(top, top + rows_in_block, count);
+			break;
+		case opcode::mul:
+			top -= rows_in_block;
+			kernel.mul(top, top + rows_in_block, count);
+			break;
+		case opcode::div:
+			top -= rows_in_block;
+			if (kernel.div(top, top + rows_in_block, count)) {
+				if (errors == nullptr)
+					return true;
+				division_by_zero = true;
+				for (size_t row = 0; row < count; row++) {
+					if (top[rows_in_block + row] == 0)
+						errors->set(first_row + row);
 				}
 			}
-			else {
-				return false;
-			}
 			break;
+		}
+	}
 
-		case states_of_waiting::number_or_left_bracket_or_symbol:
-			if (is_in_vector(numbers, infix_str[i]) || is_in_vector(left_brackets, infix_str[i]) || is_in_vector(symbols, infix_str[i])) {
-				if (is_in_vector(symbols, infix_str[i])) {
-					state = states_of_waiting::symbol_or_operation_or_right_bracket;
-				}
-				else if (is_in_vector(numbers, infix_str[i])) {
-					state = states_of_waiting::number_or_operation_or_point_or_right_bracket;
-				}
-				else if (is_in_vector(left_brackets, infix_str[i])) {
-					state = states_of_waiting::number_or_left_bracket_or_unary_minus_or_symbol;
-					if (unaryMinusIsPreviousLiteral) {
-						tmp_split.push_back(std::make_pair("-1", type_of_literal::operand));
-						tmp_split.push_back(std::make_pair("*", type_of_literal::operation));
-					}
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i,1), type_of_literal::left_bracket));
-					start = i + 1;
-				}
-				if (i == infix_str.size() - 1) {
-					state = states_of_waiting::success;
-				}
-				unaryMinusIsPreviousLiteral = false;
+	std::copy(block_stack, block_stack + count, result);
+	return division_by_zero;
+}
+
+void expression::compiled::push_operand(const token& operand, std::string_view infix) {
+	std::string_view text = infix.substr(operand.offset, operand.length);
+
+	postfix_str += text;
+	if (operand.kind == token::number) {
+		literals.push_back(operand.value);
+		program.push_back({ opcode::push_literal, (unsigned int)(literals.size() - 1) });
+		return;
+	}
+
+	const double* constant = find_constant(text);
+
+	if (constant != nullptr) {
+		literals.push_back(*constant);
+		program.push_back({ opcode::push_literal, (unsigned int)(literals.size() - 1) });
+		return;
+	}
+
+	size_t slot = std::find(slots.begin(), slots.end(), text) - slots.begin();
+
+	if (slot == slots.size())
+		slots.emplace_back(text);
+	program.push_back({ opcode::push_variable, (unsigned int)slot });
+}
+
+void expression::compiled::push_operation(const token& operation) {
+	postfix_str += operation.sign;
+
+	if (operation.kind == token::unary_minus) {
+		program.push_back({ opcode::negate, 0 });
+		return;
+	}
+	switch (operation.sign) {
+	case '+':
+		program.push_back({ opcode::add, 0 });
+		break;
+	case '-':
+		program.push_back({ opcode::sub, 0 });
+		break;
+	case '*':
+		program.push_back({ opcode::mul, 0 });
+		break;
+	case '/':
+		program.push_back({ opcode::div, 0 });
+		break;
+	}
+}
+
+int expression::priority(const token& operation) {
+	if (operation.kind == token::unary_minus)
+		return unary_minus_priority;
+	for (const auto& entry : priorities) {
+		if (entry.first == operation.sign)
+			return entry.second;
+	}
+	return 0;
+}
+
+// One pass of operator precedence parsing: operands are read and emitted as soon as they end,
+// operations wait on an explicit stack (so deep nesting can't overflow the call stack)
+// until an operation of lower priority, a closing bracket or the end of input.
+template <typename sink>
+bool expression::scan(std::string_view infix, sink& out, expression_error& failure, size_t& tokens) {
+	small_stack<token, 32> stack;
+	size_t i = 0;
+	bool unary_minus_allowed = true;
+
+	auto class_at = [&infix](size_t position) {
+		return position < infix.size() ? classes_of_chars[(unsigned char)infix[position]] : class_of_char::other;
+	};
+	auto fail = [&failure](size_t position) {
+		failure = { error_code::incorrect_input, position };
+		return false;
+	};
+	auto skip_digits = [&infix, &i] {
+		while (i < infix.size() && classes_of_chars[(unsigned char)infix[i]] == class_of_char::number)
+			i++;
+	};
+
+	while (true) {
+		// opening brackets and unary minuses before an operand
+		while (true) {
+			class_of_char c = class_at(i);
+
+			if (c == class_of_char::left_bracket) {
+				char bracket = infix[i];
+				stack.push({ token::bracket, bracket == '(' ? ')' : bracket == '[' ? ']' : '}', 1, i, 0 });
+				unary_minus_allowed = true;
+			}
+			else if (c == class_of_char::unary_minus && unary_minus_allowed && class_at(i + 1) != class_of_char::number) {
+				stack.push({ token::unary_minus, '-', 1, i, 0 });
+				unary_minus_allowed = false;
 			}
 			else {
-				return false;
+				break;
 			}
-			break;
+			i++;
+			tokens++;
+		}
 
-		case states_of_waiting::number_or_operation_or_right_bracket:
-			if (is_in_vector(right_brackets, infix_str[i]) || is_in_vector(numbers, infix_str[i]) || is_in_vector(operations, infix_str[i])) {
+		// the operand; a minus directly before a number is part of the number
+		size_t start = i;
+		class_of_char c = class_at(i);
 
-				if (is_in_vector(right_brackets, infix_str[i])) {
-					state = states_of_waiting::operation_or_right_bracket;
-					if (i == infix_str.size() - 1) {
-						state = states_of_waiting::success;
-					}
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(start, i - start),type_of_literal::operand));
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i,1),type_of_literal::right_bracket));
-				}
-				else if (is_in_vector(operations, infix_str[i])) {
-					state = states_of_waiting::number_or_left_bracket_or_symbol;
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(start, i - start), type_of_literal::operand));
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i,1), type_of_literal::operation));
-					start = i + 1;
-				}
-				else if (is_in_vector(numbers, infix_str[i])) {
-					if (i == infix_str.size() - 1) {
-						state = states_of_waiting::success;
-					}
-				}
-				unaryMinusIsPreviousLiteral = false;
+		if (c == class_of_char::number || (c == class_of_char::unary_minus && unary_minus_allowed)) {
+			i++;
+			skip_digits();
+			if (class_at(i) == class_of_char::point) {
+				i++;
+				if (class_at(i) != class_of_char::number)
+					return fail(i);
+				skip_digits();
 			}
-			else {
-				return false;
+			if (class_at(i) == class_of_char::exponent) {
+				i++;
+				if (class_at(i) == class_of_char::plus || class_at(i) == class_of_char::unary_minus)
+					i++;
+				if (class_at(i) != class_of_char::number)
+					return fail(i);
+				skip_digits();
 			}
-			break;
+		}
+		else if (c == class_of_char::symbol || c == class_of_char::exponent) {
+			while (class_at(i) == class_of_char::symbol || class_at(i) == class_of_char::exponent)
+				i++;
+		}
+		else {
+			return fail(i);
+		}
+		if (i - start > UINT32_MAX)
+			return fail(start);
 
-		case states_of_waiting::number_or_operation_or_point_or_right_bracket:
-			if (infix_str[i] == (char)special_signes::point || is_in_vector(right_brackets, infix_str[i]) || is_in_vector(numbers, infix_str[i]) || is_in_vector(operations, infix_str[i])) {
+		token operand{ c == class_of_char::symbol || c == class_of_char::exponent ? token::name : token::number, 0, (uint32_t)(i - start), start, 0 };
+		if (operand.kind == token::number && !literal::parse(infix.substr(start, i - start), operand.value)) {
+			failure = { error_code::number_out_of_range, start };
+			return false;
+		}
+		out.push_operand(operand, infix);
+		tokens++;
 
-				if (infix_str[i] == (char)special_signes::point) {
-					state = states_of_waiting::number;
-				}
-				else if (is_in_vector(right_brackets, infix_str[i])) {
-					state = states_of_waiting::operation_or_right_bracket;
-					if (i == infix_str.size() - 1) {
-						state = states_of_waiting::success;
-					}
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(start, i - start), type_of_literal::operand));
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i, 1), type_of_literal::right_bracket));
-				}
-				else if (is_in_vector(operations, infix_str[i])) {
-					state = states_of_waiting::number_or_left_bracket_or_symbol;
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(start, i - start), type_of_literal::operand));
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i, 1), type_of_literal::operation));
-					start = i + 1;
-				}
-				else if (is_in_vector(numbers, infix_str[i])) {
-					if (i == infix_str.size() - 1) {
-						state = states_of_waiting::success;
-					}
-				}
-				unaryMinusIsPreviousLiteral = false;
-			}
-			else {
-				return false;
+		// closing brackets, then an operation or the end of input
+		while (class_at(i) == class_of_char::right_bracket) {
+			while (!stack.empty() && stack.top().kind != token::bracket) {
+				out.push_operation(stack.top());
+				stack.pop();
 			}
+			if (stack.empty() || stack.top().sign != infix[i])
+				return fail(i);
+			stack.pop();
+			i++;
+			tokens++;
+		}
+
+		if (i == infix.size())
 			break;
+		c = class_at(i);
+		if (c != class_of_char::operation && c != class_of_char::plus && c != class_of_char::unary_minus)
+			return fail(i);
 
-		case states_of_waiting::number:
-			if (is_in_vector(numbers, infix_str[i])) {
-				state = states_of_waiting::number_or_operation_or_right_bracket;
-				if (i == infix_str.size() - 1) {
-					state = states_of_waiting::success;
-				}
-				unaryMinusIsPreviousLiteral = false;
+		token operation{ token::operation, infix[i], 1, i, 0 };
+		while (!stack.empty() && stack.top().kind != token::bracket && priority(stack.top()) >= priority(operation)) {
+			out.push_operation(stack.top());
+			stack.pop();
+		}
+		stack.push(operation);
+		unary_minus_allowed = false;
+		i++;
+		tokens++;
+	}
+
+	while (!stack.empty()) {
+		if (stack.top().kind == token::bracket)
+			return fail(stack.top().offset);
+		out.push_operation(stack.top());
+		stack.pop();
+	}
+	return true;
+}
+
+bool expression::compiled::scan(expression_error& failure, size_t& tokens) {
+	EXPRESSION_TIME(scan);
+
+	// the postfix text is the infix without its brackets, so it never needs to grow
+	postfix_str.reserve(infix_str.size());
+	return expression::scan(infix_str, *this, failure, tokens);
+}
+
+struct expression::one_shot {
+	small_stack<double, 64> values;
+	std::initializer_list<std::pair<std::string_view, double>> bindings;
+	resolver* source = nullptr;
+	small_stack<std::pair<std::string_view, double>, 8> resolved;
+	// the first of these is reported, but only once the whole infix has parsed, as calculate would
+	error_code first_error = error_code::none;
+
+	void push_operand(const token& operand, std::string_view infix) {
+		if (operand.kind == token::number) {
+			values.push(operand.value);
+			return;
+		}
+
+		std::string_view text = infix.substr(operand.offset, operand.length);
+		const double* constant = find_constant(text);
+		if (constant != nullptr) {
+			values.push(*constant);
+			return;
+		}
+		for (const auto& binding : bindings) {
+			if (binding.first == text) {
+				values.push(binding.second);
+				return;
 			}
-			else {
-				return false;
+		}
+		for (size_t i = 0; i < resolved.size(); i++) {
+			if (resolved[i].first == text) {
+				values.push(resolved[i].second);
+				return;
 			}
+		}
+		if (source == nullptr) {
+			if (first_error == error_code::none)
+				first_error = error_code::variable_was_not_input;
+			values.push(0);
+			return;
+		}
+		double value = source->resolve(std::string(text));
+		resolved.push({ text, value });
+		values.push(value);
+	}
+
+	void push_operation(const token& operation) {
+		if (operation.kind == token::unary_minus) {
+			values.top() = -values.top();
+			return;
+		}
+
+		double second = values.top();
+		values.pop();
+		switch (operation.sign) {
+		case '+':
+			values.top() = operate(values.top(), second, opcode::add);
+			break;
+		case '-':
+			values.top() = operate(values.top(), second, opcode::sub);
+			break;
+		case '*':
+			values.top() = operate(values.top(), second, opcode::mul);
 			break;
+		case '/':
+			if (second == 0 && first_error == error_code::none)
+				first_error = error_code::division_by_zero;
+			values.top() = operate(values.top(), second, opcode::div);
+			break;
+		}
+	}
 
-		case states_of_waiting::operation_or_right_bracket:
-			if (is_in_vector(right_brackets, infix_str[i]) || is_in_vector(operations, infix_str[i])) {
-				if (is_in_vector(operations, infix_str[i])) {
-					state = states_of_waiting::number_or_left_bracket_or_symbol;
-					if (i == infix_str.size() - 1) {
-						return false;
-					}
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i,1),type_of_literal::operation));
-					start = i + 1;
-				}
-				else {
-					if (i == infix_str.size() - 1) {
-						state = states_of_waiting::success;
-					}
-					start = i + 1;
-					tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(i,1),type_of_literal::right_bracket));
-				}
-				unaryMinusIsPreviousLiteral = false;
+	result<double> run(std::string_view infix) {
+		EXPRESSION_TIME(evaluate);
+		expression_error failure;
+		size_t tokens = 0;
+
+		for (const auto& binding : bindings) {
+			if (find_constant(binding.first) != nullptr)
+				return expression_error{ error_code::constant_was_bound };
+		}
+		if (!scan(infix, *this, failure, tokens))
+			return failure;
+		if (first_error != error_code::none)
+			return expression_error{ first_error };
+		return values.top();
+	}
+};
+
+double expression::evaluate(std::string_view infix, std::initializer_list<std::pair<std::string_view, double>> bindings) {
+	return try_evaluate(infix, bindings).value();
+}
+
+double expression::evaluate(std::string_view infix, resolver& source) {
+	return try_evaluate(infix, source).value();
+}
+
+result<double> expression::try_evaluate(std::string_view infix, std::initializer_list<std::pair<std::string_view, double>> bindings) {
+	one_shot state;
+	state.bindings = bindings;
+	return state.run(infix);
+}
+
+result<double> expression::try_evaluate(std::string_view infix, resolver& source) {
+	one_shot state;
+	state.source = &source;
+	return state.run(infix);
+}
+
+void expression::compiled::optimize() {
+	EXPRESSION_TIME(optimize);
+
+	fold_constants();
+	eliminate_common_subexpressions();
+	stack_depth = max_stack_depth();
+}
+
+void expression::compiled::fold_constants() {
+	std::vector<instruction> folded;
+	std::vector<double> folded_literals;
+	std::vector<bool> constant;
+
+	for (const instruction& i : program) {
+		switch (i.code) {
+		case opcode::push_literal:
+			folded_literals.push_back(literals[i.index]);
+			folded.push_back({ opcode::push_literal, (unsigned int)(folded_literals.size() - 1) });
+			constant.push_back(true);
+			break;
+		case opcode::push_variable:
+			folded.push_back(i);
+			constant.push_back(false);
+			break;
+		case opcode::negate:
+			if (constant.back())
+				folded_literals.back() = -folded_literals.back();
+			else if (folded.back().code == opcode::negate)
+				folded.pop_back();
+			else
+				folded.push_back(i);
+			break;
+		default: {
+			bool both_constant = constant[constant.size() - 2] && constant.back();
+			constant.pop_back();
+
+			if (both_constant && !(i.code == opcode::div && folded_literals.back() == 0)) {
+				double second = folded_literals.back();
+				folded_literals.pop_back();
+				folded.pop_back();
+				folded_literals.back() = operate(folded_literals.back(), second, i.code);
 			}
 			else {
-				return false;
+				folded.push_back(i);
+				constant.back() = false;
 			}
 			break;
 		}
+		}
 	}
 
+	program = std::move(folded);
+	literals = std::move(folded_literals);
+}
 
-	if(state == states_of_waiting::success){
-		if (is_in_vector(numbers, infix_str[infix_str.size()-1]) || is_in_vector(symbols, infix_str[infix_str.size() - 1])) {
-			tmp_split.push_back(std::pair<std::string, type_of_literal>(infix_str.substr(start, infix_str.size() - start),type_of_literal::operand));
-		};
+void expression::compiled::eliminate_common_subexpressions() {
+	const uint32_t none = UINT32_MAX;
 
-		infix = tmp_split;
-		return true;
-	}
+	struct node {
+		instruction leaf;
+		uint64_t key;
+		uint32_t first;
+		uint32_t second;
+		uint32_t parents;
+		uint32_t temp;
+	};
 
-	return false;
-}
+	std::vector<node> nodes;
+	std::vector<uint32_t> operands;
+	nodes.reserve(program.size());
 
-double expression::calculate() {
-	std::stack<double> values;
-	
-	double first_op, second_op;
+	// open addressing; a bucket keeps the node index plus one, zero when empty, next to the upper bits
+	// of the hash, so probing past other nodes doesn't load them
+	size_t buckets = 16;
+	while (buckets < program.size() * 2)
+		buckets *= 2;
+	std::vector<std::pair<uint32_t, uint32_t>> known(buckets);
+	bool shared = false;
 
-	for (auto i : postfix) {
-		std::string literal = i.first;
-		if (i.second == type_of_literal::operand) {
-			if (is_in_vector(symbols, i.first.back())) {
-				if (i.first.front() == (char)special_signes::unary_minus)
-					literal = literal.substr(1);
-				if (variables.find(literal) == variables.end()) throw "variable was not input";
-				values.push(variables[literal] * (1 - 2 * (int)(i.first.front() == (char)special_signes::unary_minus)));
+	auto intern = [&](instruction leaf, uint64_t key, uint32_t first, uint32_t second) {
+		uint64_t hash = (key ^ ((uint64_t)first << 32 | second) * 0x9e3779b97f4a7c15ull) + (uint64_t)leaf.code;
+		hash = (hash ^ (hash >> 31)) * 0xbf58476d1ce4e5b9ull;
+		hash ^= hash >> 29;
+		uint32_t tag = (uint32_t)(hash >> 32);
+
+		for (size_t bucket = hash & (buckets - 1);; bucket = (bucket + 1) & (buckets - 1)) {
+			if (known[bucket].first == 0) {
+				known[bucket] = { (uint32_t)nodes.size() + 1, tag };
+				nodes.push_back({ leaf, key, first, second, 0, none });
+				if (first != none)
+					nodes[first].parents++;
+				if (second != none)
+					nodes[second].parents++;
+				return (uint32_t)nodes.size() - 1;
 			}
-			else {
-				values.push(std::stod(literal));
+			if (known[bucket].second != tag)
+				continue;
+
+			uint32_t index = known[bucket].first - 1;
+			const node& n = nodes[index];
+			if (n.leaf.code == leaf.code && n.key == key && n.first == first && n.second == second) {
+				shared |= first != none;
+				return index;
 			}
 		}
-			
-		else {
-			second_op = values.top();
-			values.pop();
-			first_op = values.top();
-			values.pop();
-			values.push(operate(first_op, second_op, i.first.front()));
-		}	
+	};
+
+	for (const instruction& i : program) {
+		switch (i.code) {
+		case opcode::push_literal: {
+			uint64_t bits;
+			std::memcpy(&bits, &literals[i.index], sizeof(bits));
+			operands.push_back(intern(i, bits, none, none));
+			break;
+		}
+		case opcode::push_variable:
+			operands.push_back(intern(i, i.index, none, none));
+			break;
+		case opcode::negate:
+			operands.back() = intern(i, 0, operands.back(), none);
+			break;
+		default: {
+			uint32_t second = operands.back();
+			operands.pop_back();
+			uint32_t first = operands.back();
+			if ((i.code == opcode::add || i.code == opcode::mul) && first > second)
+				std::swap(first, second);
+			operands.back() = intern(i, 0, first, second);
+			break;
+		}
+		}
+	}
+
+	// nothing repeats, so the program is already what would be emitted
+	if (!shared) {
+		eliminated_nodes = 0;
+		temp_count = 0;
+		return;
 	}
-	
-	return values.top();
-}
 
-void expression::to_postfix() {
-	std::stack<std::pair<std::string, type_of_literal>> stack;
+	std::vector<instruction> emitted;
+	emitted.reserve(program.size());
+	std::vector<std::pair<uint32_t, bool>> pending = { { operands.back(), false } };
+	size_t computed = 0;
 
-	for (const auto& literal : infix) {
-		if (literal.second == type_of_literal::operand) {
-			postfix.push_back(std::pair<std::string, type_of_literal>(literal.first, literal.second));
+	temp_count = 0;
+
+	while (!pending.empty()) {
+		auto [index, expanded] = pending.back();
+		pending.pop_back();
+		node& n = nodes[index];
+
+		if (n.temp != none) {
+			emitted.push_back({ opcode::push_temp, (unsigned int)n.temp });
 		}
-		else if (literal.second == type_of_literal::left_bracket) {
-			stack.push(std::pair<std::string, type_of_literal>(literal.first, literal.second));
+		else if (n.first == none) {
+			emitted.push_back(n.leaf);
+			computed++;
 		}
-		else if (literal.second == type_of_literal::right_bracket) {
-			while (!stack.empty() && stack.top().second != type_of_literal::left_bracket) {
-				postfix.push_back(std::pair<std::string, type_of_literal>(stack.top().first, stack.top().second));
-				stack.pop();
-			}
-			stack.pop();
+		else if (!expanded) {
+			pending.push_back({ index, true });
+			if (n.second != none)
+				pending.push_back({ n.second, false });
+			pending.push_back({ n.first, false });
 		}
-		else if (literal.second == type_of_literal::operation){
-			while (!stack.empty() && stack.top().second == type_of_literal::operation && (*priorities.find(literal.first[0])).second <= (*priorities.find(stack.top().first[0])).second) {
-				postfix.push_back(stack.top());
-				stack.pop();
+		else {
+			emitted.push_back({ n.leaf.code, 0 });
+			computed++;
+			if (n.parents > 1) {
+				n.temp = temp_count++;
+				emitted.push_back({ opcode::store_temp, (unsigned int)n.temp });
 			}
-			stack.push(literal);
 		}
 	}
-	while (!stack.empty()) {
-		postfix.push_back(stack.top());
-		stack.pop();
+
+	eliminated_nodes = program.size() - computed;
+	program = std::move(emitted);
+}
+
+size_t expression::compiled::max_stack_depth() const {
+	size_t depth = 0;
+	size_t max_depth = 0;
+
+	for (const instruction& i : program) {
+		if (i.code == opcode::push_literal || i.code == opcode::push_variable || i.code == opcode::push_temp)
+			max_depth = std::max(max_depth, ++depth);
+		else if (i.code != opcode::negate && i.code != opcode::store_temp)
+			depth--;
 	}
-	for (auto& literal : postfix)
-		postfix_str += literal.first;
+	return max_depth;
 }
 
-void expression::request_variables() {
-	double value;
+bool expression::compile_native() {
+	if (!code)
+		return false;
+	if (code->native)
+		return true;
 
-	for (auto var : infix) {
-		if (is_in_vector(symbols, var.first.back())) {
-			if (var.first.front() == (char)special_signes::unary_minus && variables.find(var.first.substr(1)) == variables.end()) {
-				std::cout << var.first.substr(1) << " = ";
-				std::cin >> value;
-				std::cout << std::endl;
-				variables.emplace(var.first.substr(1), -value);
-			}
+	std::vector<jit::operation> operations;
 
-			else if(variables.find(var.first) == variables.end()){
-				std::cout << var.first << " = ";
-				std::cin >> value;
-				std::cout << std::endl;
-				variables.emplace(var.first, value);
-			}
+	for (const instruction& i : code->program) {
+		switch (i.code) {
+		case opcode::push_literal:
+			operations.push_back({ jit::kind::load_literal, 0, code->literals[i.index] });
+			break;
+		case opcode::push_variable:
+			operations.push_back({ jit::kind::load_slot, i.index, 0 });
+			break;
+		case opcode::push_temp:
+			operations.push_back({ jit::kind::load_temp, i.index, 0 });
+			break;
+		case opcode::store_temp:
+			operations.push_back({ jit::kind::store_temp, i.index, 0 });
+			break;
+		case opcode::negate:
+			operations.push_back({ jit::kind::negate, 0, 0 });
+			break;
+		case opcode::add:
+			operations.push_back({ jit::kind::add, 0, 0 });
+			break;
+		case opcode::sub:
+			operations.push_back({ jit::kind::sub, 0, 0 });
+			break;
+		case opcode::mul:
+			operations.push_back({ jit::kind::mul, 0, 0 });
+			break;
+		case opcode::div:
+			operations.push_back({ jit::kind::div, 0, 0 });
+			break;
 		}
 	}
+
+	std::shared_ptr<jit::native_code> native = jit::compile(operations);
+	if (!native)
+		return false;
+
+	auto upgraded = std::make_shared<compiled>(*code);
+	upgraded->native = std::move(native);
+	code = std::move(upgraded);
+	return true;
 }
 
+std::vector<std::string> expression::get_unbound_variables() const {
+	std::vector<std::string> names;
+
+	for (size_t i = 0; i < bound_slots.size(); i++) {
+		if (!bound_slots[i])
+			names.push_back(code->slots[i]);
+	}
+	return names;
+}
+
+void expression::resolve(resolver& source) {
+	EXPRESSION_TIME(resolve);
+	std::vector<std::string> names = get_unbound_variables();
+	std::vector<double> values(names.size());
+
+	if (names.empty())
+		return;
+	source.resolve(names, values.data());
+	for (size_t i = 0; i < names.size(); i++)
+		bind(names[i], values[i]);
+}
+
+std::future<void> expression::resolve_async(resolver& source) {
+	std::vector<std::string> names = get_unbound_variables();
+
+	if (names.empty()) {
+		std::promise<void> ready;
+		ready.set_value();
+		return ready.get_future();
+	}
+
+	std::future<std::vector<double>> values = source.resolve_async(names);
+	return std::async(std::launch::deferred, [this, names = std::move(names), values = std::move(values)]() mutable {
+		std::vector<double> fetched = values.get();
+		if (fetched.size() != names.size())
+			throw "wrong number of values";
+		for (size_t i = 0; i < names.size(); i++)
+			bind(names[i], fetched[i]);
+	});
+}
+
+namespace {
+
+struct fetch {
+	resolver& source;
+	std::vector<std::string> names;
+	std::vector<double> values;
+	std::exception_ptr error;
+
+	bool await_ready() const {
+		return names.empty();
+	}
+	void await_suspend(std::coroutine_handle<> awaiting) {
+		source.resolve_then(names, [this, awaiting](std::vector<double> fetched, std::exception_ptr failure) {
+			values = std::move(fetched);
+			error = failure;
+			awaiting.resume();
+		});
+	}
+	std::vector<double> await_resume() {
+		if (error)
+			std::rethrow_exception(error);
+		return std::move(values);
+	}
+};
+
+}
+
+calculation expression::calculate_async(resolver& source) const {
+	expression self = *this;
+	std::vector<std::string> names = self.get_unbound_variables();
+	fetch pending{ source, names, {}, nullptr };
+	std::vector<double> values = co_await pending;
+
+	if (values.size() != names.size())
+		throw "wrong number of values";
+	for (size_t i = 0; i < names.size(); i++)
+		self.bind(names[i], values[i]);
+	co_return self.calculate();
+}
@@ -0,0 +1,123 @@
+#include "expression_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+expression_cache::expression_cache(size_t memory_budget, size_t shard_count) : budget(memory_budget) {
+	shard_count = std::max<size_t>(shard_count, 1);
+
+	for (size_t i = 0; i < shard_count; i++)
+		shards.push_back(std::make_unique<shard>());
+}
+
+expression_cache& expression_cache::instance() {
+	static expression_cache cache;
+	return cache;
+}
+
+expression_cache::shard& expression_cache::shard_of(const std::string& infix) {
+	return *shards[std::hash<std::string>()(infix) % shards.size()];
+}
+
+void expression_cache::evict(shard& target, size_t limit) {
+	while (target.bytes > limit && !target.recent.empty()) {
+		auto victim = target.entries.find(*target.recent.back());
+		target.bytes -= victim->second.cost;
+		target.recent.pop_back();
+		target.entries.erase(victim);
+		evictions++;
+	}
+}
+
+std::shared_ptr<const expression::compiled> expression_cache::find(const std::string& infix) {
+	shard& target = shard_of(infix);
+	{
+		std::lock_guard<std::mutex> lock(target.mutex);
+
+		auto found = target.entries.find(infix);
+		if (found != target.entries.end()) {
+			target.recent.splice(target.recent.begin(), target.recent, found->second.position);
+			hits++;
+			return found->second.program;
+		}
+	}
+	misses++;
+	if (file_count == 0)
+		return nullptr;
+
+	std::vector<std::shared_ptr<const program_file>> attached;
+	{
+		std::lock_guard<std::mutex> lock(files_mutex);
+		attached = files;
+	}
+	for (const auto& file : attached) {
+		std::shared_ptr<const expression::compiled> program = file->find(infix);
+		if (program) {
+			loads++;
+			insert(infix, program);
+			return program;
+		}
+	}
+	return nullptr;
+}
+
+void expression_cache::attach(std::shared_ptr<const program_file> file) {
+	std::lock_guard<std::mutex> lock(files_mutex);
+	files.push_back(std::move(file));
+	file_count = files.size();
+}
+
+void expression_cache::detach(const std::shared_ptr<const program_file>& file) {
+	std::lock_guard<std::mutex> lock(files_mutex);
+	files.erase(std::remove(files.begin(), files.end(), file), files.end());
+	file_count = files.size();
+}
+
+void expression_cache::insert(const std::string& infix, std::shared_ptr<const expression::compiled> program) {
+	size_t cost = sizeof(entry) + infix.capacity() + program->memory_size();
+	size_t limit = budget / shards.size();
+
+	if (cost > limit)
+		return;
+
+	shard& target = shard_of(infix);
+	std::lock_guard<std::mutex> lock(target.mutex);
+
+	auto inserted = target.entries.emplace(infix, entry{ std::move(program), cost, {} });
+	if (!inserted.second)
+		return;
+
+	target.recent.push_front(&inserted.first->first);
+	inserted.first->second.position = target.recent.begin();
+	target.bytes += cost;
+	evict(target, limit);
+}
+
+void expression_cache::set_budget(size_t memory_budget) {
+	budget = memory_budget;
+
+	for (auto& target : shards) {
+		std::lock_guard<std::mutex> lock(target->mutex);
+		evict(*target, memory_budget / shards.size());
+	}
+}
+
+void expression_cache::clear() {
+	for (auto& target : shards) {
+		std::lock_guard<std::mutex> lock(target->mutex);
+		target->entries.clear();
+		target->recent.clear();
+		target->bytes = 0;
+	}
+}
+
+expression_cache::statistics expression_cache::get_statistics() {
+	statistics result{ hits, misses, evictions, loads, 0, 0 };
+
+	for (auto& target : shards) {
+		std::lock_guard<std::mutex> lock(target->mutex);
+		result.entries += target->entries.size();
+		result.bytes += target->bytes;
+	}
+	return result;
+}
@@ -0,0 +1,159 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace instrumentation {
+
+namespace {
+
+struct phase_cells {
+	std::atomic<uint64_t> calls{ 0 };
+	std::atomic<uint64_t> nanoseconds{ 0 };
+	std::atomic<uint64_t> allocations{ 0 };
+};
+
+struct counter_cells {
+	std::atomic<uint64_t> total{ 0 };
+	std::atomic<uint64_t> maximum{ 0 };
+};
+
+struct thread_counters {
+	std::array<phase_cells, (size_t)phase::count> phases;
+	std::array<counter_cells, (size_t)counter::count> counters;
+
+	thread_counters();
+	~thread_counters();
+};
+
+struct registry {
+	std::mutex mutex;
+	std::vector<thread_counters*> live;
+	snapshot retired;
+};
+
+// never destroyed, so threads that exit during static destruction can still retire their counters
+registry& get_registry() {
+	static registry* instance = new registry;
+	return *instance;
+}
+
+void add_to(snapshot& result, const thread_counters& counters) {
+	for (size_t i = 0; i < result.phases.size(); i++) {
+		result.phases[i].calls += counters.phases[i].calls.load(std::memory_order_relaxed);
+		result.phases[i].nanoseconds += counters.phases[i].nanoseconds.load(std::memory_order_relaxed);
+		result.phases[i].allocations += counters.phases[i].allocations.load(std::memory_order_relaxed);
+	}
+	for (size_t i = 0; i < result.counters.size(); i++) {
+		result.counters[i].total += counters.counters[i].total.load(std::memory_order_relaxed);
+		result.counters[i].maximum = std::max(result.counters[i].maximum, counters.counters[i].maximum.load(std::memory_order_relaxed));
+	}
+}
+
+thread_counters::thread_counters() {
+	registry& shared = get_registry();
+	std::lock_guard<std::mutex> lock(shared.mutex);
+	shared.live.push_back(this);
+}
+
+thread_counters::~thread_counters() {
+	registry& shared = get_registry();
+	std::lock_guard<std::mutex> lock(shared.mutex);
+	add_to(shared.retired, *this);
+	shared.live.erase(std::find(shared.live.begin(), shared.live.end(), this));
+}
+
+thread_local thread_counters local;
+
+#ifdef EXPRESSION_INSTRUMENTATION
+thread_local uint64_t allocation_count = 0;
+#endif
+
+}
+
+const char* name(phase measured) {
+	static const char* names[] = { "scan", "optimize", "resolve", "calculate", "calculate_batch", "evaluate" };
+	return names[(size_t)measured];
+}
+
+const char* name(counter measured) {
+	static const char* names[] = { "tokens", "postfix_length", "stack_depth", "rows" };
+	return names[(size_t)measured];
+}
+
+snapshot collect() {
+	registry& shared = get_registry();
+	std::lock_guard<std::mutex> lock(shared.mutex);
+	snapshot result = shared.retired;
+
+	for (const thread_counters* counters : shared.live)
+		add_to(result, *counters);
+	return result;
+}
+
+void reset() {
+	registry& shared = get_registry();
+	std::lock_guard<std::mutex> lock(shared.mutex);
+
+	shared.retired = snapshot();
+	for (thread_counters* counters : shared.live) {
+		for (phase_cells& cells : counters->phases) {
+			cells.calls = 0;
+			cells.nanoseconds = 0;
+			cells.allocations = 0;
+		}
+		for (counter_cells& cells : counters->counters) {
+			cells.total = 0;
+			cells.maximum = 0;
+		}
+	}
+}
+
+void record(phase measured, uint64_t nanoseconds, uint64_t allocations) {
+	phase_cells& cells = local.phases[(size_t)measured];
+
+	cells.calls.fetch_add(1, std::memory_order_relaxed);
+	cells.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+	cells.allocations.fetch_add(allocations, std::memory_order_relaxed);
+}
+
+void add(counter measured, uint64_t value) {
+	counter_cells& cells = local.counters[(size_t)measured];
+
+	cells.total.fetch_add(value, std::memory_order_relaxed);
+	uint64_t maximum = cells.maximum.load(std::memory_order_relaxed);
+	while (value > maximum && !cells.maximum.compare_exchange_weak(maximum, value, std::memory_order_relaxed))
+		;
+}
+
+uint64_t allocations_on_this_thread() {
+#ifdef EXPRESSION_INSTRUMENTATION
+	return allocation_count;
+#else
+	return 0;
+#endif
+}
+
+}
+
+#ifdef EXPRESSION_INSTRUMENTATION
+void* operator new(std::size_t size) {
+	instrumentation::allocation_count++;
+	void* memory = std::malloc(size != 0 ? size : 1);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+#endif
@@ -0,0 +1,307 @@
+#include "jit.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define JIT_X86_64_LINUX
+#endif
+
+namespace jit {
+
+#ifdef JIT_X86_64_LINUX
+
+namespace {
+
+// Operand stack entry i lives in xmm<i>. xmm13 holds zero, xmm14 is scratch,
+// xmm15 accumulates the "divisor == 0" compare mask.
+const int zero_register = 13;
+const int scratch_register = 14;
+const int mask_register = 15;
+
+enum class form {
+	scalar,
+	packed
+};
+
+class assembler {
+	struct fixup {
+		size_t position;
+		size_t constant;
+	};
+
+	std::vector<unsigned char> code;
+	std::vector<double> constants;
+	std::vector<fixup> fixups;
+
+	void byte(unsigned char value) {
+		code.push_back(value);
+	}
+
+	void dword(uint32_t value) {
+		for (int i = 0; i < 4; i++)
+			byte((unsigned char)(value >> (8 * i)));
+	}
+
+	void rex(int reg, int index, int base, bool wide = false) {
+		unsigned char value = 0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+		if (value != 0x40)
+			byte(value);
+	}
+
+	size_t constant_pair(double value) {
+		for (size_t i = 0; i < constants.size(); i += 2) {
+			if (std::memcmp(&constants[i], &value, sizeof(double)) == 0)
+				return i / 2;
+		}
+		constants.push_back(value);
+		constants.push_back(value);
+		return constants.size() / 2 - 1;
+	}
+
+public:
+	// op xmm<reg>, xmm<rm>
+	void sse(unsigned char prefix, unsigned char opcode, int reg, int rm) {
+		byte(prefix);
+		rex(reg, 0, rm);
+		byte(0x0F);
+		byte(opcode);
+		byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+	}
+
+	// op xmm<reg>, [rip + constant]
+	void sse_constant(unsigned char prefix, unsigned char opcode, int reg, double value) {
+		byte(prefix);
+		rex(reg, 0, 0);
+		byte(0x0F);
+		byte(opcode);
+		byte(0x05 | ((reg & 7) << 3));
+		fixups.push_back({ code.size(), constant_pair(value) });
+		dword(0);
+	}
+
+	// op xmm<reg>, [<base> + disp32]; base must not be rsp or r12
+	void sse_based(unsigned char prefix, unsigned char opcode, int reg, int base, uint32_t displacement) {
+		byte(prefix);
+		rex(reg, 0, base);
+		byte(0x0F);
+		byte(opcode);
+		byte(0x80 | ((reg & 7) << 3) | (base & 7));
+		dword(displacement);
+	}
+
+	// op xmm<reg>, [<base> + r10]
+	void sse_indexed(unsigned char prefix, unsigned char opcode, int reg, int base) {
+		byte(prefix);
+		rex(reg, 10, base);
+		byte(0x0F);
+		byte(opcode);
+		byte(0x04 | ((reg & 7) << 3));
+		byte(((10 & 7) << 3) | (base & 7));
+	}
+
+	void raw(std::initializer_list<unsigned char> bytes) {
+		for (unsigned char value : bytes)
+			byte(value);
+	}
+
+	void raw_dword(uint32_t value) {
+		dword(value);
+	}
+
+	size_t position() const {
+		return code.size();
+	}
+
+	void patch_relative(size_t position, size_t target) {
+		uint32_t relative = (uint32_t)(target - (position + 4));
+		std::memcpy(&code[position], &relative, 4);
+	}
+
+	void align(size_t alignment) {
+		while (code.size() % alignment != 0)
+			byte(0xCC);
+	}
+
+	std::shared_ptr<native_code> finish(size_t scalar_entry, size_t batch_entry) {
+		align(16);
+		size_t pool = code.size();
+		for (const fixup& f : fixups)
+			patch_relative(f.position, pool + 16 * f.constant);
+		size_t size = pool + constants.size() * sizeof(double);
+
+		void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+			return nullptr;
+		std::memcpy(memory, code.data(), pool);
+		std::memcpy((char*)memory + pool, constants.data(), constants.size() * sizeof(double));
+		if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+			munmap(memory, size);
+			return nullptr;
+		}
+
+		auto result = std::make_shared<native_code>(memory, size);
+		result->scalar = (scalar_function)((char*)memory + scalar_entry);
+		result->batch = (batch_function)((char*)memory + batch_entry);
+		return result;
+	}
+};
+
+const unsigned char prefix_scalar = 0xF2;
+const unsigned char prefix_packed = 0x66;
+
+const int rdi = 7;
+const int rdx = 2;
+const int r8 = 8;
+const int r9 = 9;
+
+void emit_body(assembler& a, const std::vector<operation>& program, form f) {
+	unsigned char prefix = f == form::scalar ? prefix_scalar : prefix_packed;
+	int temps = f == form::scalar ? rdx : r8;
+	uint32_t temp_size = f == form::scalar ? sizeof(double) : 2 * sizeof(double);
+	int depth = 0;
+
+	for (const operation& op : program) {
+		switch (op.code) {
+		case kind::load_slot:
+			if (f == form::scalar) {
+				a.sse_based(prefix_scalar, 0x10, depth, rdi, op.slot * sizeof(double));
+			}
+			else {
+				// mov r9, [rdi + 8 * slot]; movupd xmm<depth>, [r9 + r10]
+				a.raw({ 0x4C, 0x8B, 0x8F });
+				a.raw_dword(op.slot * sizeof(void*));
+				a.sse_indexed(prefix_packed, 0x10, depth, r9);
+			}
+			depth++;
+			break;
+		case kind::load_temp:
+			// movsd / movupd xmm<depth>, [temps + size * temp]
+			a.sse_based(prefix, 0x10, depth, temps, op.slot * temp_size);
+			depth++;
+			break;
+		case kind::store_temp:
+			// movsd / movupd [temps + size * temp], xmm<top>
+			a.sse_based(prefix, 0x11, depth - 1, temps, op.slot * temp_size);
+			break;
+		case kind::load_literal:
+			// movsd / movapd xmm<depth>, [rip + literal]
+			a.sse_constant(prefix, f == form::scalar ? 0x10 : 0x28, depth, op.value);
+			depth++;
+			break;
+		case kind::negate:
+			// xorpd xmm<top>, [rip + sign mask]
+			a.sse_constant(prefix_packed, 0x57, depth - 1, -0.0);
+			break;
+		case kind::add:
+			a.sse(prefix, 0x58, depth - 2, depth - 1);
+			depth--;
+			break;
+		case kind::sub:
+			a.sse(prefix, 0x5C, depth - 2, depth - 1);
+			depth--;
+			break;
+		case kind::mul:
+			a.sse(prefix, 0x59, depth - 2, depth - 1);
+			depth--;
+			break;
+		case kind::div:
+			// movapd scratch, divisor; cmpeq scratch, zero; orpd mask, scratch
+			a.sse(prefix_packed, 0x28, scratch_register, depth - 1);
+			a.sse(prefix, 0xC2, scratch_register, zero_register);
+			a.raw({ 0x00 });
+			a.sse(prefix_packed, 0x56, mask_register, scratch_register);
+			a.sse(prefix, 0x5E, depth - 2, depth - 1);
+			depth--;
+			break;
+		}
+	}
+}
+
+void emit_prologue(assembler& a) {
+	a.sse(prefix_packed, 0x57, zero_register, zero_register);
+	a.sse(prefix_packed, 0x57, mask_register, mask_register);
+}
+
+// double f(const double* slots /* rdi */, unsigned int* division_by_zero /* rsi */, double* temps /* rdx */)
+void emit_scalar(assembler& a, const std::vector<operation>& program) {
+	emit_prologue(a);
+	emit_body(a, program, form::scalar);
+	// movmskpd eax, xmm15; and eax, 1; mov [rsi], eax; ret
+	a.raw({ 0x66, 0x41, 0x0F, 0x50, 0xC7, 0x83, 0xE0, 0x01, 0x89, 0x06, 0xC3 });
+}
+
+// void f(const double* const* columns /* rdi */, double* result /* rsi */, size_t pairs /* rdx */,
+//        unsigned int* division_by_zero /* rcx */, double* temps /* r8 */)
+void emit_batch(assembler& a, const std::vector<operation>& program) {
+	emit_prologue(a);
+	// xor r10d, r10d; test rdx, rdx; jz done
+	a.raw({ 0x45, 0x31, 0xD2, 0x48, 0x85, 0xD2, 0x0F, 0x84 });
+	size_t to_done = a.position();
+	a.raw_dword(0);
+
+	size_t loop = a.position();
+	emit_body(a, program, form::packed);
+	// movupd [rsi + r10], xmm0; add r10, 16; dec rdx; jnz loop
+	a.raw({ 0x66, 0x42, 0x0F, 0x11, 0x04, 0x16, 0x49, 0x83, 0xC2, 0x10, 0x48, 0xFF, 0xCA, 0x0F, 0x85 });
+	size_t to_loop = a.position();
+	a.raw_dword(0);
+	a.patch_relative(to_loop, loop);
+
+	a.patch_relative(to_done, a.position());
+	// movmskpd eax, xmm15; mov [rcx], eax; ret
+	a.raw({ 0x66, 0x41, 0x0F, 0x50, 0xC7, 0x89, 0x01, 0xC3 });
+}
+
+}
+
+native_code::native_code(void* memory, size_t size) : memory(memory), size(size) {}
+
+native_code::~native_code() {
+	munmap(memory, size);
+}
+
+bool is_available() {
+	return true;
+}
+
+std::shared_ptr<native_code> compile(const std::vector<operation>& program) {
+	size_t depth = 0;
+
+	for (const operation& op : program) {
+		if (op.code == kind::load_slot || op.code == kind::load_literal || op.code == kind::load_temp)
+			depth++;
+		else if (op.code != kind::negate && op.code != kind::store_temp)
+			depth--;
+		if (depth > max_depth)
+			return nullptr;
+	}
+	if (depth != 1)
+		return nullptr;
+
+	assembler a;
+	size_t scalar_entry = a.position();
+	emit_scalar(a, program);
+	a.align(16);
+	size_t batch_entry = a.position();
+	emit_batch(a, program);
+	return a.finish(scalar_entry, batch_entry);
+}
+
+#else
+
+native_code::native_code(void* memory, size_t size) : memory(memory), size(size) {}
+
+native_code::~native_code() {}
+
+bool is_available() {
+	return false;
+}
+
+std::shared_ptr<native_code> compile(const std::vector<operation>&) {
+	return nullptr;
+}
+
+#endif
+
+}
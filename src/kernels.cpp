@@ -0,0 +1,205 @@
+#include "kernels.h"
+
+#include <atomic>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86
+#endif
+
+namespace kernels {
+
+namespace {
+
+void add_scalar(double* first, const double* second, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		first[i] += second[i];
+}
+
+void sub_scalar(double* first, const double* second, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		first[i] -= second[i];
+}
+
+void mul_scalar(double* first, const double* second, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		first[i] *= second[i];
+}
+
+bool div_scalar(double* first, const double* second, size_t count) {
+	bool zero = false;
+	for (size_t i = 0; i < count; i++) {
+		zero |= second[i] == 0;
+		first[i] /= second[i];
+	}
+	return zero;
+}
+
+void negate_scalar(double* values, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		values[i] = -values[i];
+}
+
+#ifdef KERNELS_X86
+
+#define BINARY_KERNEL(name, instructions, width, load, store, operation, tail)     \
+	__attribute__((target(instructions))) void name(double* first, const double* second, size_t count) { \
+		size_t i = 0;                                                                \
+		for (; i + width <= count; i += width)                                       \
+			store(first + i, operation(load(first + i), load(second + i)));          \
+		tail(first + i, second + i, count - i);                                      \
+	}
+
+BINARY_KERNEL(add_sse2, "sse2", 2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, add_scalar)
+BINARY_KERNEL(sub_sse2, "sse2", 2, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd, sub_scalar)
+BINARY_KERNEL(mul_sse2, "sse2", 2, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd, mul_scalar)
+
+BINARY_KERNEL(add_avx2, "avx2", 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, add_scalar)
+BINARY_KERNEL(sub_avx2, "avx2", 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd, sub_scalar)
+BINARY_KERNEL(mul_avx2, "avx2", 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd, mul_scalar)
+
+BINARY_KERNEL(add_avx512, "avx512f", 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, add_scalar)
+BINARY_KERNEL(sub_avx512, "avx512f", 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_sub_pd, sub_scalar)
+BINARY_KERNEL(mul_avx512, "avx512f", 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_mul_pd, mul_scalar)
+
+#undef BINARY_KERNEL
+
+__attribute__((target("sse2"))) bool div_sse2(double* first, const double* second, size_t count) {
+	__m128d zero = _mm_setzero_pd();
+	__m128d mask = _mm_setzero_pd();
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128d divisor = _mm_loadu_pd(second + i);
+		mask = _mm_or_pd(mask, _mm_cmpeq_pd(divisor, zero));
+		_mm_storeu_pd(first + i, _mm_div_pd(_mm_loadu_pd(first + i), divisor));
+	}
+	return (_mm_movemask_pd(mask) != 0) | div_scalar(first + i, second + i, count - i);
+}
+
+__attribute__((target("avx2"))) bool div_avx2(double* first, const double* second, size_t count) {
+	__m256d zero = _mm256_setzero_pd();
+	__m256d mask = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256d divisor = _mm256_loadu_pd(second + i);
+		mask = _mm256_or_pd(mask, _mm256_cmp_pd(divisor, zero, _CMP_EQ_OQ));
+		_mm256_storeu_pd(first + i, _mm256_div_pd(_mm256_loadu_pd(first + i), divisor));
+	}
+	return (_mm256_movemask_pd(mask) != 0) | div_scalar(first + i, second + i, count - i);
+}
+
+__attribute__((target("avx512f"))) bool div_avx512(double* first, const double* second, size_t count) {
+	__m512d zero = _mm512_setzero_pd();
+	__mmask8 mask = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m512d divisor = _mm512_loadu_pd(second + i);
+		mask |= _mm512_cmp_pd_mask(divisor, zero, _CMP_EQ_OQ);
+		_mm512_storeu_pd(first + i, _mm512_div_pd(_mm512_loadu_pd(first + i), divisor));
+	}
+	return (mask != 0) | div_scalar(first + i, second + i, count - i);
+}
+
+__attribute__((target("sse2"))) void negate_sse2(double* values, size_t count) {
+	__m128d sign = _mm_set1_pd(-0.0);
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_pd(values + i, _mm_xor_pd(_mm_loadu_pd(values + i), sign));
+	negate_scalar(values + i, count - i);
+}
+
+__attribute__((target("avx2"))) void negate_avx2(double* values, size_t count) {
+	__m256d sign = _mm256_set1_pd(-0.0);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd(values + i, _mm256_xor_pd(_mm256_loadu_pd(values + i), sign));
+	negate_scalar(values + i, count - i);
+}
+
+__attribute__((target("avx512f"))) void negate_avx512(double* values, size_t count) {
+	__m512i sign = _mm512_set1_epi64((long long)0x8000000000000000ull);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m512i bits = _mm512_castpd_si512(_mm512_loadu_pd(values + i));
+		_mm512_storeu_pd(values + i, _mm512_castsi512_pd(_mm512_xor_si512(bits, sign)));
+	}
+	negate_scalar(values + i, count - i);
+}
+
+#endif
+
+const table tables[] = {
+	{ isa::scalar, add_scalar, sub_scalar, mul_scalar, div_scalar, negate_scalar },
+#ifdef KERNELS_X86
+	{ isa::sse2, add_sse2, sub_sse2, mul_sse2, div_sse2, negate_sse2 },
+	{ isa::avx2, add_avx2, sub_avx2, mul_avx2, div_avx2, negate_avx2 },
+	{ isa::avx512, add_avx512, sub_avx512, mul_avx512, div_avx512, negate_avx512 },
+#endif
+};
+
+std::atomic<const table*> current{ nullptr };
+
+}
+
+bool is_supported(isa set) {
+#ifdef KERNELS_X86
+	__builtin_cpu_init();
+	switch (set) {
+	case isa::scalar:
+		return true;
+	case isa::sse2:
+		return __builtin_cpu_supports("sse2");
+	case isa::avx2:
+		return __builtin_cpu_supports("avx2");
+	case isa::avx512:
+		return __builtin_cpu_supports("avx512f");
+	}
+	return false;
+#else
+	return set == isa::scalar;
+#endif
+}
+
+isa best_isa() {
+	for (isa set : { isa::avx512, isa::avx2, isa::sse2 }) {
+		if (is_supported(set))
+			return set;
+	}
+	return isa::scalar;
+}
+
+const char* name(isa set) {
+	switch (set) {
+	case isa::scalar:
+		return "scalar";
+	case isa::sse2:
+		return "sse2";
+	case isa::avx2:
+		return "avx2";
+	case isa::avx512:
+		return "avx512";
+	}
+	return "unknown";
+}
+
+const table& get(isa set) {
+	if (!is_supported(set))
+		throw "instruction set is not supported";
+	return tables[(size_t)set];
+}
+
+const table& selected() {
+	const table* result = current.load(std::memory_order_acquire);
+	if (result == nullptr) {
+		result = &get(best_isa());
+		current.store(result, std::memory_order_release);
+	}
+	return *result;
+}
+
+void select(isa set) {
+	current.store(&get(set), std::memory_order_release);
+}
+
+}
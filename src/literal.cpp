@@ -0,0 +1,72 @@
+#include "literal.h"
+
+#include <charconv>
+#include <cstdint>
+
+namespace literal {
+
+static const double powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Clinger's fast path: a mantissa below 2^53 and a power of ten up to 1e22 are both exact
+// doubles, so one multiplication or division rounds correctly. Everything else goes to
+// from_chars, which is correctly rounded as well.
+static bool parse_fast(std::string_view text, double& value) {
+	const uint64_t max_exact = uint64_t(1) << 53;
+	size_t i = 0;
+	bool negative = false;
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+
+	if (i < text.size() && text[i] == '-') {
+		negative = true;
+		i++;
+	}
+	for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, digits++)
+		mantissa = mantissa * 10 + (text[i] - '0');
+	if (i < text.size() && text[i] == '.') {
+		for (i++; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, digits++, exponent--)
+			mantissa = mantissa * 10 + (text[i] - '0');
+	}
+	if (digits == 0 || digits > 19)
+		return false;
+	if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+		bool negative_exponent = false;
+		int written = 0;
+		int exponent_digits = 0;
+
+		i++;
+		if (i < text.size() && (text[i] == '+' || text[i] == '-'))
+			negative_exponent = text[i++] == '-';
+		for (; i < text.size() && text[i] >= '0' && text[i] <= '9' && exponent_digits < 4; i++, exponent_digits++)
+			written = written * 10 + (text[i] - '0');
+		if (exponent_digits == 0 || exponent_digits == 4)
+			return false;
+		exponent += negative_exponent ? -written : written;
+	}
+	if (i != text.size() || mantissa > max_exact || exponent < -22 || exponent > 22)
+		return false;
+
+	value = (double)mantissa;
+	value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+	if (negative)
+		value = -value;
+	return true;
+}
+
+bool parse(std::string_view text, double& value) {
+	if (parse_fast(text, value))
+		return true;
+
+	double result;
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), result);
+	if (error != std::errc() || end != text.data() + text.size())
+		return false;
+	value = result;
+	return true;
+}
+
+}
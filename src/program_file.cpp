@@ -0,0 +1,327 @@
+#include "program_file.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PROGRAM_FILE_MMAP
+#endif
+
+static const char magic[8] = { 'E', 'X', 'P', 'R', 'P', 'R', 'O', 'G' };
+
+uint64_t program_file::hash(const char* text, size_t length) {
+	uint64_t result = 14695981039346656037ull;
+
+	for (size_t i = 0; i < length; i++)
+		result = (result ^ (unsigned char)text[i]) * 1099511628211ull;
+	return result;
+}
+
+uint64_t program_file::checksum(const unsigned char* data, size_t length) {
+	// four independent lanes so the multiplications overlap
+	uint64_t lanes[4] = { length, ~length, length * 31, length * 131 };
+	size_t i = 0;
+
+	for (; i + 32 <= length; i += 32) {
+		for (size_t lane = 0; lane < 4; lane++) {
+			uint64_t word;
+			std::memcpy(&word, data + i + lane * 8, sizeof(word));
+			lanes[lane] = (lanes[lane] ^ word) * 0x9e3779b97f4a7c15ull;
+			lanes[lane] ^= lanes[lane] >> 29;
+		}
+	}
+
+	uint64_t result = lanes[0] ^ (lanes[1] * 3) ^ (lanes[2] * 5) ^ (lanes[3] * 7);
+	for (; i < length; i++)
+		result = (result ^ data[i]) * 1099511628211ull;
+	return result;
+}
+
+program_file::program_file(const std::string& path) {
+#ifdef PROGRAM_FILE_MMAP
+	int descriptor = open(path.c_str(), O_RDONLY);
+	struct stat info;
+
+	if (descriptor < 0)
+		throw "can't open program file";
+	if (fstat(descriptor, &info) != 0 || (size_t)info.st_size < sizeof(header)) {
+		close(descriptor);
+		throw "program file is corrupted";
+	}
+
+	length = info.st_size;
+	// not populated: only the pages find reaches are read
+	void* memory = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+	if (memory == MAP_FAILED)
+		throw "can't open program file";
+	data = static_cast<const unsigned char*>(memory);
+#else
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+		throw "can't open program file";
+	contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (contents.size() < sizeof(header))
+		throw "program file is corrupted";
+
+	length = contents.size();
+	data = contents.data();
+#endif
+
+	const header& head = get_header();
+	const char* error = nullptr;
+
+	if (std::memcmp(head.magic, magic, sizeof(magic)) != 0 || head.size != length)
+		error = "program file is corrupted";
+	else if (head.version != version)
+		error = "program file has another version";
+	else if ((head.buckets & (head.buckets - 1)) != 0 || head.buckets > length / sizeof(uint32_t) || head.count > length / sizeof(record)
+		|| !in_bounds(sizeof(header), head.count * sizeof(record) + head.buckets * sizeof(uint32_t)))
+		error = "program file is corrupted";
+
+	if (error != nullptr) {
+#ifdef PROGRAM_FILE_MMAP
+		munmap(memory, length);
+#endif
+		throw error;
+	}
+}
+
+program_file::~program_file() {
+#ifdef PROGRAM_FILE_MMAP
+	munmap(const_cast<unsigned char*>(data), length);
+#endif
+}
+
+const program_file::header& program_file::get_header() const {
+	return *reinterpret_cast<const header*>(data);
+}
+
+const program_file::record* program_file::records() const {
+	return reinterpret_cast<const record*>(data + sizeof(header));
+}
+
+const uint32_t* program_file::buckets() const {
+	return reinterpret_cast<const uint32_t*>(records() + get_header().count);
+}
+
+bool program_file::in_bounds(uint64_t offset, uint64_t size) const {
+	return offset <= length && size <= length - offset;
+}
+
+size_t program_file::size() const {
+	return get_header().count;
+}
+
+void program_file::verify() const {
+	if (checksum(data + sizeof(header), length - sizeof(header)) != get_header().checksum)
+		throw "program file is corrupted";
+}
+
+uint64_t program_file::record_checksum(const unsigned char* data, const record& r) {
+	uint64_t fields = checksum(reinterpret_cast<const unsigned char*>(&r), offsetof(record, checksum));
+	return checksum(data + r.body.offset, r.body.length) ^ fields * 0x9e3779b97f4a7c15ull;
+}
+
+std::shared_ptr<const expression::compiled> program_file::find(const std::string& infix) const {
+	const header& head = get_header();
+	uint64_t key = hash(infix.data(), infix.size());
+
+	for (uint64_t probe = 0; probe < head.buckets; probe++) {
+		uint32_t index = buckets()[(key + probe) & (head.buckets - 1)];
+		if (index == 0 || index > head.count)
+			return nullptr;
+
+		const record& r = records()[index - 1];
+		if (r.hash != key || r.infix.length != infix.size() || !in_bounds(r.infix.offset, r.infix.length)
+			|| std::memcmp(data + r.infix.offset, infix.data(), infix.size()) != 0)
+			continue;
+
+		{
+			std::lock_guard<std::mutex> lock(loaded_mutex);
+			auto found = loaded.find(index);
+			if (found != loaded.end())
+				return found->second;
+		}
+
+		std::shared_ptr<const expression::compiled> program = load(r, infix);
+		std::lock_guard<std::mutex> lock(loaded_mutex);
+		return loaded.emplace(index, std::move(program)).first->second;
+	}
+	return nullptr;
+}
+
+std::shared_ptr<const expression::compiled> program_file::load(const record& r, const std::string& infix) const {
+	auto in_body = [&r](uint64_t offset, uint64_t size) {
+		return offset >= r.body.offset && size <= r.body.length && offset - r.body.offset <= r.body.length - size;
+	};
+
+	if (!in_bounds(r.body.offset, r.body.length) || record_checksum(data, r) != r.checksum)
+		throw "program file is corrupted";
+	if (!in_body(r.postfix.offset, r.postfix.length) || !in_body(r.names, (uint64_t)r.name_count * sizeof(text))
+		|| !in_body(r.program, (uint64_t)r.program_length * 2 * sizeof(uint32_t)) || !in_body(r.literals, (uint64_t)r.literal_count * sizeof(double)))
+		throw "program file is corrupted";
+
+	auto program = std::make_shared<expression::compiled>();
+	program->infix_str = infix;
+	program->postfix_str.assign(reinterpret_cast<const char*>(data + r.postfix.offset), r.postfix.length);
+
+	const text* names = reinterpret_cast<const text*>(data + r.names);
+	for (uint32_t i = 0; i < r.name_count; i++) {
+		if (!in_body(names[i].offset, names[i].length))
+			throw "program file is corrupted";
+		program->slots.emplace_back(reinterpret_cast<const char*>(data + names[i].offset), names[i].length);
+	}
+
+	// the checksum only catches accidental damage, so the program is checked before anything runs it;
+	// every temp is written by a store_temp, so there can't be more temps than instructions
+	if (r.temp_count > r.program_length)
+		throw "program file is corrupted";
+
+	const uint32_t* instructions = reinterpret_cast<const uint32_t*>(data + r.program);
+	size_t depth = 0;
+	program->program.reserve(r.program_length);
+	for (uint32_t i = 0; i < r.program_length; i++) {
+		uint32_t code = instructions[2 * i];
+		uint32_t index = instructions[2 * i + 1];
+		bool valid = false;
+
+		if (code > (uint32_t)expression::opcode::div)
+			throw "program file is corrupted";
+		switch ((expression::opcode)code) {
+		case expression::opcode::push_literal:
+			valid = index < r.literal_count;
+			depth++;
+			break;
+		case expression::opcode::push_variable:
+			valid = index < r.name_count;
+			depth++;
+			break;
+		case expression::opcode::push_temp:
+			valid = index < r.temp_count;
+			depth++;
+			break;
+		case expression::opcode::store_temp:
+			valid = index < r.temp_count && depth >= 1;
+			break;
+		case expression::opcode::negate:
+			valid = depth >= 1;
+			break;
+		case expression::opcode::add:
+		case expression::opcode::sub:
+		case expression::opcode::mul:
+		case expression::opcode::div:
+			valid = depth >= 2;
+			depth--;
+			break;
+		}
+		if (!valid)
+			throw "program file is corrupted";
+		program->program.push_back({ (expression::opcode)code, index });
+	}
+	if (depth != 1)
+		throw "program file is corrupted";
+
+	const double* literals = reinterpret_cast<const double*>(data + r.literals);
+	program->literals.assign(literals, literals + r.literal_count);
+	program->stack_depth = program->max_stack_depth();
+	program->temp_count = r.temp_count;
+	program->eliminated_nodes = r.eliminated_nodes;
+	return program;
+}
+
+size_t program_file::write(const std::string& path, const std::vector<std::string>& infixes) {
+	std::vector<std::shared_ptr<const expression::compiled>> programs;
+	std::unordered_set<std::string> seen;
+
+	for (const std::string& infix : infixes) {
+		if (!seen.insert(infix).second)
+			continue;
+		try {
+			programs.push_back(std::make_shared<const expression::compiled>(infix));
+		}
+		catch (const char*) {
+		}
+	}
+
+	uint64_t bucket_count = 1;
+	while (bucket_count < programs.size() * 2)
+		bucket_count *= 2;
+
+	size_t tables = sizeof(header) + programs.size() * sizeof(record) + bucket_count * sizeof(uint32_t);
+	std::vector<unsigned char> file((tables + 7) / 8 * 8);
+	std::vector<record> index(programs.size());
+	std::vector<uint32_t> table(bucket_count, 0);
+
+	auto append = [&file](const void* source, size_t size) {
+		uint64_t offset = file.size();
+		file.resize(offset + (size + 7) / 8 * 8);
+		if (size != 0)
+			std::memcpy(file.data() + offset, source, size);
+		return offset;
+	};
+	auto append_text = [&append](const std::string& str) {
+		return text{ append(str.data(), str.size()), str.size() };
+	};
+
+	for (size_t i = 0; i < programs.size(); i++) {
+		const expression::compiled& program = *programs[i];
+		record& r = index[i];
+		uint64_t body = file.size();
+
+		std::vector<text> names;
+		for (const std::string& slot : program.slots)
+			names.push_back(append_text(slot));
+		std::vector<uint32_t> instructions;
+		for (const auto& instruction : program.program) {
+			instructions.push_back((uint32_t)instruction.code);
+			instructions.push_back(instruction.index);
+		}
+
+		r.hash = hash(program.infix_str.data(), program.infix_str.size());
+		r.infix = append_text(program.infix_str);
+		r.postfix = append_text(program.postfix_str);
+		r.names = append(names.data(), names.size() * sizeof(text));
+		r.program = append(instructions.data(), instructions.size() * sizeof(uint32_t));
+		r.literals = append(program.literals.data(), program.literals.size() * sizeof(double));
+		r.name_count = (uint32_t)names.size();
+		r.program_length = (uint32_t)program.program.size();
+		r.literal_count = (uint32_t)program.literals.size();
+		r.stack_depth = (uint32_t)program.stack_depth;
+		r.temp_count = (uint32_t)program.temp_count;
+		r.eliminated_nodes = (uint32_t)program.eliminated_nodes;
+		r.body = { body, file.size() - body };
+		r.checksum = record_checksum(file.data(), r);
+
+		uint64_t bucket = r.hash & (bucket_count - 1);
+		while (table[bucket] != 0)
+			bucket = (bucket + 1) & (bucket_count - 1);
+		table[bucket] = (uint32_t)(i + 1);
+	}
+
+	header head{};
+	std::memcpy(head.magic, magic, sizeof(magic));
+	head.version = version;
+	head.count = (uint32_t)programs.size();
+	head.buckets = bucket_count;
+	head.size = file.size();
+
+	std::memcpy(file.data() + sizeof(header), index.data(), index.size() * sizeof(record));
+	std::memcpy(file.data() + sizeof(header) + index.size() * sizeof(record), table.data(), table.size() * sizeof(uint32_t));
+	head.checksum = checksum(file.data() + sizeof(header), file.size() - sizeof(header));
+	std::memcpy(file.data(), &head, sizeof(header));
+
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(file.data()), file.size());
+	if (!out)
+		throw "can't write program file";
+	return programs.size();
+}
@@ -0,0 +1,86 @@
+#include "resolver.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+void resolver::resolve(const std::vector<std::string>& names, double* values) {
+	for (size_t i = 0; i < names.size(); i++)
+		values[i] = resolve(names[i]);
+}
+
+std::future<std::vector<double>> resolver::resolve_async(std::vector<std::string> names) {
+	return std::async(std::launch::async, [this, names = std::move(names)] {
+		std::vector<double> values(names.size());
+		resolve(names, values.data());
+		return values;
+	});
+}
+
+void resolver::resolve_then(std::vector<std::string> names, std::function<void(std::vector<double> values, std::exception_ptr error)> done) {
+	struct fetches {
+		std::vector<std::string> names;
+		std::vector<double> values;
+		std::function<void(std::vector<double> values, std::exception_ptr error)> done;
+		std::atomic<size_t> remaining;
+		std::mutex mutex;
+		std::exception_ptr error;
+	};
+
+	if (names.empty()) {
+		done({}, nullptr);
+		return;
+	}
+
+	auto shared = std::make_shared<fetches>();
+	shared->values.resize(names.size());
+	shared->remaining = names.size();
+	shared->names = std::move(names);
+	shared->done = std::move(done);
+
+	for (size_t i = 0; i < shared->names.size(); i++) {
+		std::thread([this, shared, i] {
+			try {
+				shared->values[i] = resolve(shared->names[i]);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				if (!shared->error)
+					shared->error = std::current_exception();
+			}
+			if (--shared->remaining != 0)
+				return;
+			if (shared->error)
+				shared->done({}, shared->error);
+			else
+				shared->done(std::move(shared->values), nullptr);
+		}).detach();
+	}
+}
+
+console_resolver::console_resolver(std::istream& in, std::ostream& out) : in(in), out(out) {
+}
+
+double console_resolver::resolve(const std::string& name) {
+	double value;
+
+	out << name << " = ";
+	if (!(in >> value))
+		throw "variable was not input";
+	out << std::endl;
+	return value;
+}
+
+void console_resolver::resolve_then(std::vector<std::string> names, std::function<void(std::vector<double> values, std::exception_ptr error)> done) {
+	std::vector<double> values(names.size());
+
+	try {
+		resolve(names, values.data());
+	}
+	catch (...) {
+		done({}, std::current_exception());
+		return;
+	}
+	done(std::move(values), nullptr);
+}
@@ -0,0 +1,40 @@
+#include "result.h"
+
+#include <bit>
+
+const char* expression_error::message() const {
+	switch (code) {
+	case error_code::none:
+		return "no error";
+	case error_code::incorrect_input:
+	case error_code::number_out_of_range:
+		return "incorrect input";
+	case error_code::division_by_zero:
+		return "division by zero";
+	case error_code::variable_was_not_input:
+		return "variable was not input";
+	case error_code::expression_is_empty:
+		return "expression is empty";
+	case error_code::wrong_number_of_columns:
+		return "wrong number of columns";
+	case error_code::constant_was_bound:
+		return "you can't change constants";
+	}
+	return "unknown error";
+}
+
+size_t row_errors::count() const {
+	size_t result = 0;
+
+	for (uint64_t word : words)
+		result += std::popcount(word);
+	return result;
+}
+
+bool row_errors::any() const {
+	for (uint64_t word : words) {
+		if (word != 0)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,143 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+
+size_t thread_pool::configured_size = 0;
+std::atomic<bool> thread_pool::instance_created{ false };
+
+thread_pool::thread_pool(size_t threads) {
+	threads = std::max<size_t>(threads, 1);
+
+	for (size_t i = 0; i < threads; i++)
+		queues.push_back(std::make_unique<queue>());
+	for (size_t i = 0; i < threads; i++)
+		workers.emplace_back(&thread_pool::work, this, i);
+}
+
+thread_pool::~thread_pool() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void thread_pool::configure(size_t threads) {
+	if (instance_created)
+		throw "thread pool is already running";
+	configured_size = threads;
+}
+
+size_t thread_pool::instance_size() {
+	instance_created = true;
+	return configured_size != 0 ? configured_size : std::thread::hardware_concurrency();
+}
+
+thread_pool& thread_pool::instance() {
+	static thread_pool pool(instance_size());
+	return pool;
+}
+
+size_t thread_pool::size() const {
+	return workers.size();
+}
+
+void thread_pool::push(std::function<void()> task) {
+	queue& target = *queues[next_queue++ % queues.size()];
+	// counted before it is visible, so a thief can't decrement pending below zero
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		pending++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(target.mutex);
+		target.tasks.push_back(std::move(task));
+	}
+	wake.notify_one();
+}
+
+bool thread_pool::try_run(size_t home) {
+	std::function<void()> task;
+
+	for (size_t i = 0; i < queues.size() && !task; i++) {
+		queue& victim = *queues[(home + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.tasks.empty())
+			continue;
+		if (i == 0) {
+			task = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+		}
+		else {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+		}
+	}
+	if (!task)
+		return false;
+
+	pending--;
+	task();
+	return true;
+}
+
+void thread_pool::work(size_t home) {
+	while (true) {
+		if (try_run(home))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this] { return stopping || pending != 0; });
+		if (stopping && pending == 0)
+			return;
+	}
+}
+
+void thread_pool::parallel_for(size_t count, size_t chunk, const std::function<void(size_t begin, size_t end)>& body) {
+	if (count == 0)
+		return;
+	chunk = std::max<size_t>(chunk, 1);
+
+	size_t chunks = (count + chunk - 1) / chunk;
+	if (chunks == 1) {
+		body(0, count);
+		return;
+	}
+
+	std::atomic<size_t> remaining{ chunks };
+	std::mutex done_mutex;
+	std::condition_variable done;
+	std::exception_ptr error;
+
+	for (size_t begin = 0; begin < count; begin += chunk) {
+		size_t end = std::min(count, begin + chunk);
+		push([&, begin, end] {
+			try {
+				body(begin, end);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(done_mutex);
+				if (!error)
+					error = std::current_exception();
+			}
+			std::lock_guard<std::mutex> lock(done_mutex);
+			if (--remaining == 0)
+				done.notify_all();
+		});
+	}
+
+	size_t home = next_queue % queues.size();
+	while (remaining != 0) {
+		if (try_run(home))
+			continue;
+		std::unique_lock<std::mutex> lock(done_mutex);
+		done.wait(lock, [&] { return remaining == 0; });
+	}
+
+	std::lock_guard<std::mutex> lock(done_mutex);
+	if (error)
+		std::rethrow_exception(error);
+}
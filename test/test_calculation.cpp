@@ -0,0 +1,208 @@
+#include "expression.h"
+#include <gtest.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <thread>
+
+// answers lookups on its own worker threads after a short delay, like a remote store
+class delayed_resolver : public resolver {
+	using request = std::pair<std::vector<std::string>, std::function<void(std::vector<double>, std::exception_ptr)>>;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<request> requests;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+
+	void work() {
+		for (;;) {
+			std::deque<request> taken;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !requests.empty(); });
+				if (requests.empty())
+					return;
+				taken.swap(requests);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			for (auto& r : taken) {
+				std::vector<double> values;
+				try {
+					for (const auto& name : r.first)
+						values.push_back(resolve(name));
+				}
+				catch (...) {
+					r.second({}, std::current_exception());
+					continue;
+				}
+				r.second(std::move(values), nullptr);
+			}
+		}
+	}
+
+public:
+	std::map<std::string, double> values;
+	std::atomic<int> fetches{ 0 };
+
+	explicit delayed_resolver(size_t threads) {
+		for (size_t i = 0; i < threads; i++)
+			workers.emplace_back(&delayed_resolver::work, this);
+	}
+
+	~delayed_resolver() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	double resolve(const std::string& name) override {
+		auto found = values.find(name);
+		if (found == values.end())
+			throw "unknown variable";
+		return found->second;
+	}
+
+	void resolve_then(std::vector<std::string> names, std::function<void(std::vector<double>, std::exception_ptr)> done) override {
+		fetches++;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			requests.emplace_back(std::move(names), std::move(done));
+		}
+		wake.notify_one();
+	}
+};
+
+class inline_resolver : public resolver {
+public:
+	double resolve(const std::string& name) override {
+		return name == "a" ? 2 : 3;
+	}
+};
+
+class failing_resolver : public resolver {
+public:
+	double resolve(const std::string& name) override {
+		if (name == "b")
+			throw "unknown variable";
+		return 1;
+	}
+};
+
+// every lookup waits until the others have started, so it only finishes quickly when they overlap
+class rendezvous_resolver : public resolver {
+	std::mutex mutex;
+	std::condition_variable arrived;
+	size_t arrivals = 0;
+	size_t expected;
+
+public:
+	std::atomic<int> overlapped{ 0 };
+
+	explicit rendezvous_resolver(size_t expected) : expected(expected) {
+	}
+
+	double resolve(const std::string& name) override {
+		std::unique_lock<std::mutex> lock(mutex);
+		arrivals++;
+		arrived.notify_all();
+		if (arrived.wait_for(lock, std::chrono::seconds(2), [this] { return arrivals >= expected; }))
+			overlapped++;
+		return name == "x" ? 1 : name == "y" ? 2 : 4;
+	}
+};
+
+static calculation sum_of(const expression& first, const expression& second, resolver& source) {
+	double a = co_await first.calculate_async(source);
+	double b = co_await second.calculate_async(source);
+	co_return a + b;
+}
+
+TEST(calculation, can_calculate_with_inline_resolver) {
+	inline_resolver source;
+	expression ex("a*b+1");
+
+	EXPECT_EQ(ex.calculate_async(source).get(), 7.0);
+}
+
+TEST(calculation, default_resolver_fetches_variables_concurrently) {
+	rendezvous_resolver source(3);
+	expression ex("x+y*z");
+
+	EXPECT_EQ(ex.calculate_async(source).get(), 9.0);
+	EXPECT_EQ(source.overlapped, 3);
+}
+
+TEST(calculation, throw_if_default_fetch_fails) {
+	failing_resolver source;
+	expression ex("a+b");
+
+	ASSERT_ANY_THROW(ex.calculate_async(source).get());
+}
+
+TEST(calculation, does_not_fetch_bound_variables) {
+	delayed_resolver source(1);
+	source.values = { {"b", 4} };
+	expression ex("a-b", { {"a", 1} });
+
+	EXPECT_EQ(ex.calculate_async(source).get(), -3.0);
+	EXPECT_EQ(source.fetches, 1);
+	EXPECT_EQ(ex.get_unbound_variables(), std::vector<std::string>({ "b" }));
+}
+
+TEST(calculation, does_not_suspend_without_unbound_variables) {
+	delayed_resolver source(1);
+	expression ex("a/2", { {"a", 5} });
+
+	calculation result = ex.calculate_async(source);
+
+	EXPECT_TRUE(result.is_done());
+	EXPECT_EQ(result.get(), 2.5);
+	EXPECT_EQ(source.fetches, 0);
+}
+
+TEST(calculation, can_await_calculations) {
+	delayed_resolver source(2);
+	source.values = { {"x", 3}, {"y", 5} };
+	expression first("x*y");
+	expression second("y-x");
+
+	EXPECT_EQ(sum_of(first, second, source).get(), 17.0);
+}
+
+TEST(calculation, many_calculations_share_few_threads) {
+	delayed_resolver source(2);
+	source.values = { {"x", 2}, {"y", 0.5} };
+	expression ex("x/y+x");
+	std::vector<calculation> pending;
+
+	for (int i = 0; i < 2000; i++)
+		pending.push_back(ex.calculate_async(source));
+
+	for (auto& result : pending)
+		EXPECT_EQ(result.get(), 6.0);
+}
+
+TEST(calculation, throw_if_fetch_fails) {
+	delayed_resolver source(1);
+	expression ex("unknown+1");
+
+	calculation result = ex.calculate_async(source);
+
+	ASSERT_ANY_THROW(result.get());
+}
+
+TEST(calculation, throw_if_div_by_zero_after_fetch) {
+	delayed_resolver source(1);
+	source.values = { {"z", 0} };
+	expression ex("1/z");
+
+	calculation result = ex.calculate_async(source);
+
+	ASSERT_ANY_THROW(result.get());
+}
@@ -1,6 +1,9 @@
 #include "expression.h"
 #include <gtest.h>
 
+#include <thread>
+#include <type_traits>
+
 TEST(expression, throw_if_div_by_zero_number) {
 	expression ex("1/0");
 	ASSERT_ANY_THROW(ex.calculate());
@@ -279,4 +282,424 @@ TEST(expression, can_add_and_devide_correctly) {
 	expression ex("1+1/2");
 
 	EXPECT_EQ(ex.calculate(), 1.5);
-}
\ No newline at end of file
+}
+
+TEST(expression, can_calculate_ex_with_mixed_brackets) {
+	expression ex("{2*[1+(3-1)]}/(-[4])");
+
+	EXPECT_EQ(ex.calculate(), -1.5);
+}
+
+TEST(expression, throw_ex_with_mismatched_bracket_kinds) {
+
+	ASSERT_ANY_THROW(expression ex("(1+2]"));
+}
+
+TEST(expression, throw_ex_with_unknown_character) {
+
+	ASSERT_ANY_THROW(expression ex("1+2#3"));
+}
+
+TEST(expression, throw_ex_with_digit_after_variable) {
+
+	ASSERT_ANY_THROW(expression ex("a1+2"));
+}
+
+TEST(expression, throw_ex_with_trailing_operation) {
+
+	ASSERT_ANY_THROW(expression ex("(1+2)*"));
+}
+
+TEST(expression, can_calculate_same_ex_repeatedly) {
+	expression ex("(a+1.5)*b-a/4", { {"a", 2}, {"b", 3} });
+
+	EXPECT_EQ(ex.calculate(), 10.0);
+	EXPECT_EQ(ex.calculate(), 10.0);
+}
+
+TEST(expression, can_calculate_ex_with_repeated_variable) {
+	expression ex("a*a-(-a)", { {"a", 3} });
+
+	EXPECT_EQ(ex.calculate(), 12.0);
+}
+
+TEST(expression, can_calculate_ex_with_constants) {
+	expression ex("2*pi-e");
+
+	EXPECT_DOUBLE_EQ(ex.calculate(), 2 * 3.14159265358979323846 - 2.71828182845904523536);
+}
+
+TEST(expression, can_calculate_copy_of_ex) {
+	expression ex("1+2*3");
+	expression copy(ex);
+
+	EXPECT_EQ(copy.calculate(), 7.0);
+}
+
+TEST(expression, throw_if_variable_was_not_input) {
+	expression ex("a+1");
+
+	ASSERT_ANY_THROW(ex.calculate());
+}
+
+TEST(expression, can_calculate_batch_by_columns) {
+	expression ex("(a+1)*b-a/4");
+	std::vector<std::string> names = ex.get_variables();
+	std::vector<double> a(1000), b(1000), result(1000);
+	for (size_t i = 0; i < a.size(); i++) {
+		a[i] = i * 0.5;
+		b[i] = 3.0 - i;
+	}
+
+	std::vector<expression::column> columns(names.size());
+	for (size_t i = 0; i < names.size(); i++)
+		columns[i].data = names[i] == "a" ? a.data() : b.data();
+	ex.calculate(columns, result.data(), result.size());
+
+	for (size_t i = 0; i < a.size(); i++)
+		EXPECT_EQ(result[i], (a[i] + 1) * b[i] - a[i] / 4);
+}
+
+TEST(expression, can_calculate_batch_with_stride_and_bound_variable) {
+	expression ex("a*b+pi", { {"b", 2} });
+	double rows[] = { 1, -1, 2, -2, 3, -3 };
+	double result[3];
+
+	ex.calculate({ {"a", {rows, 2}} }, result, 3);
+
+	EXPECT_DOUBLE_EQ(result[0], 2 + 3.14159265358979323846);
+	EXPECT_DOUBLE_EQ(result[1], 4 + 3.14159265358979323846);
+	EXPECT_DOUBLE_EQ(result[2], 6 + 3.14159265358979323846);
+}
+
+TEST(expression, throw_if_batch_column_was_not_input) {
+	expression ex("a*b");
+	double a[] = { 1, 2 };
+	double result[2];
+
+	ASSERT_ANY_THROW(ex.calculate({ {"a", {a}} }, result, 2));
+}
+
+TEST(expression, throw_if_batch_expression_is_empty) {
+	expression ex;
+	double a[] = { 1, 2 };
+	double result[2];
+
+	ASSERT_ANY_THROW(ex.calculate({ {"a", {a}} }, result, 2));
+}
+
+TEST(expression, throw_if_div_by_zero_in_batch) {
+	expression ex("1/a");
+	double a[] = { 1, 0, 2 };
+	double result[3];
+
+	ASSERT_ANY_THROW(ex.calculate({ {"a", {a}} }, result, 3));
+}
+
+TEST(expression, can_calculate_batch_on_thread_pool) {
+	expression ex("a*a-b/2", { {"b", 3} });
+	std::vector<double> a(100000), result(a.size());
+	for (size_t i = 0; i < a.size(); i++)
+		a[i] = i * 0.25;
+	thread_pool pool(4);
+
+	ex.calculate({ {a.data()}, {} }, result.data(), result.size(), pool);
+
+	for (size_t i = 0; i < a.size(); i++)
+		EXPECT_EQ(result[i], a[i] * a[i] - 1.5);
+}
+
+TEST(expression, throw_if_div_by_zero_in_parallel_batch) {
+	expression ex("1/a");
+	std::vector<double> a(50000, 1.0), result(a.size());
+	a[31337] = 0;
+	thread_pool pool(4);
+
+	ASSERT_ANY_THROW(ex.calculate({ {a.data()} }, result.data(), result.size(), pool));
+}
+
+TEST(expression, native_code_matches_interpreter) {
+	const char* formulas[] = { "4", "-4", "-(-(-a))", "2-(-a)", "-1.2+3.04-10", "-a/(-b)", "1+2*3",
+		"{2*[a+(3-b)]}/(-[4])", "(a+1.5)*b-a/4", "2*pi-e", "a*a-(-a)/b*(b-a)+7.25" };
+
+	for (const char* formula : formulas) {
+		expression interpreted(formula, { {"a", 1.75}, {"b", -3} });
+		expression native(formula, { {"a", 1.75}, {"b", -3} });
+		if (!native.compile_native())
+			continue;
+
+		EXPECT_EQ(native.calculate(), interpreted.calculate()) << formula;
+	}
+}
+
+TEST(expression, native_batch_matches_interpreter) {
+	expression interpreted("(a-b)*a/4+b");
+	expression native(interpreted);
+	if (!native.compile_native())
+		return;
+	std::vector<double> a(777), b(777), expected(777), result(777);
+	for (size_t i = 0; i < a.size(); i++) {
+		a[i] = i * 0.5 - 3;
+		b[i] = 1.0 / (i + 1);
+	}
+
+	interpreted.calculate({ {"a", {a.data()}}, {"b", {b.data()}} }, expected.data(), a.size());
+	native.calculate({ {"a", {a.data()}}, {"b", {b.data()}} }, result.data(), a.size());
+
+	EXPECT_EQ(result, expected);
+}
+
+TEST(expression, throw_if_div_by_zero_in_native_code) {
+	expression ex("1/(a-2)", { {"a", 2} });
+	ex.compile_native();
+
+	ASSERT_ANY_THROW(ex.calculate());
+}
+
+TEST(expression, can_calculate_ex_with_constant_subexpressions) {
+	expression ex("2*pi*r+(3+4)*x-(-(2*3))", { {"r", 0.5}, {"x", 2} });
+
+	EXPECT_DOUBLE_EQ(ex.calculate(), 3.14159265358979323846 + 14 + 6);
+}
+
+TEST(expression, can_calculate_ex_that_folds_to_constant) {
+	expression ex("(1+2)*[4-1]/{-(-e)}");
+
+	EXPECT_DOUBLE_EQ(ex.calculate(), 9 / 2.71828182845904523536);
+}
+
+TEST(expression, constants_are_not_variables) {
+	expression ex("pi*x+e");
+
+	EXPECT_EQ(ex.get_variables(), std::vector<std::string>{ "x" });
+}
+
+TEST(expression, throw_if_div_by_constant_zero) {
+	expression ex("2*pi/(3-3)");
+
+	ASSERT_ANY_THROW(ex.calculate());
+}
+
+TEST(expression, unary_minus_is_an_operation_in_postfix) {
+	expression ex("-(a+b)*c");
+
+	EXPECT_EQ(ex.get_postfix(), "ab+-c*");
+}
+
+TEST(expression, can_calculate_ex_with_many_nested_unary_minuses) {
+	expression ex("-(-(-(-(-a*b))))", { {"a", 2}, {"b", 5} });
+
+	EXPECT_EQ(ex.calculate(), -10.0);
+}
+
+TEST(expression, can_calculate_ex_with_common_subexpressions) {
+	expression ex("(a-b)/(a-b+c)*(a-b)", { {"a", 5}, {"b", 3}, {"c", 2} });
+
+	EXPECT_EQ(ex.calculate(), 1.0);
+	EXPECT_EQ(ex.get_eliminated_nodes(), 6);
+}
+
+TEST(expression, common_subexpressions_respect_commutativity) {
+	expression ex("a*b+b*a-(b-a)", { {"a", 2}, {"b", 7} });
+
+	EXPECT_EQ(ex.calculate(), 23.0);
+	EXPECT_EQ(ex.get_eliminated_nodes(), 3);
+}
+
+TEST(expression, nothing_is_eliminated_without_repeats) {
+	expression ex("a*b+c", { {"a", 2}, {"b", 7}, {"c", 1} });
+
+	EXPECT_EQ(ex.get_eliminated_nodes(), 0);
+}
+
+TEST(expression, can_eliminate_many_distinct_subexpressions) {
+	const int count = 2000;
+	std::string infix = "0";
+	double expected = 0;
+	for (int i = 1; i <= count; i++) {
+		infix += "+(x+" + std::to_string(i) + ")*(x+" + std::to_string(i) + ")";
+		expected += (0.5 + i) * (0.5 + i);
+	}
+	expression ex(infix, { {"x", 0.5} });
+
+	EXPECT_EQ(ex.calculate(), expected);
+	EXPECT_EQ(ex.get_eliminated_nodes(), 3 * count);
+}
+
+TEST(expression, can_calculate_batch_with_common_subexpressions) {
+	expression ex("(a-b)*(a-b)/(-(a-b)+0.25)");
+	std::vector<double> a(301), b(301), result(301);
+	for (size_t i = 0; i < a.size(); i++) {
+		a[i] = i * 0.5;
+		b[i] = 1.0 * (i % 5);
+	}
+
+	ex.calculate({ {"a", {a.data()}}, {"b", {b.data()}} }, result.data(), a.size());
+
+	for (size_t i = 0; i < a.size(); i++)
+		EXPECT_EQ(result[i], (a[i] - b[i]) * (a[i] - b[i]) / (-(a[i] - b[i]) + 0.25));
+
+	if (ex.compile_native()) {
+		std::vector<double> native(301);
+		ex.calculate({ {"a", {a.data()}}, {"b", {b.data()}} }, native.data(), a.size());
+		EXPECT_EQ(native, result);
+	}
+}
+
+TEST(expression, throw_if_constant_is_input) {
+
+	ASSERT_ANY_THROW(expression ex("pi*r", { {"pi", 3}, {"r", 1} }));
+}
+
+TEST(expression, throw_if_variable_is_input_twice) {
+
+	ASSERT_ANY_THROW(expression ex("a+1", { {"a", 3}, {"a", 1} }));
+}
+
+TEST(expression, copy_keeps_variables) {
+	expression ex("a*b", { {"a", 3}, {"b", 4} });
+	expression copy(ex);
+
+	EXPECT_EQ(copy.calculate(), 12.0);
+}
+
+TEST(expression, copy_shares_compiled_program) {
+	expression ex("a*b+a", { {"a", 3}, {"b", 4} });
+	expression copy;
+	copy = ex;
+
+	EXPECT_EQ(copy.get_postfix(), ex.get_postfix());
+	EXPECT_EQ(copy.calculate(), 15.0);
+}
+
+TEST(expression, can_move_ex) {
+	static_assert(std::is_nothrow_move_constructible<expression>::value, "expression move must not throw");
+	static_assert(std::is_nothrow_move_assignable<expression>::value, "expression move must not throw");
+
+	expression ex("a-b", { {"a", 3}, {"b", 4} });
+	expression moved(std::move(ex));
+	expression assigned;
+	assigned = std::move(moved);
+
+	EXPECT_EQ(assigned.calculate(), -1.0);
+}
+
+TEST(expression, vector_of_ex_keeps_variables_on_growth) {
+	std::vector<expression> formulas;
+
+	for (int i = 0; i < 1000; i++)
+		formulas.emplace_back("a+1", std::initializer_list<std::pair<std::string, double>>{ {"a", (double)i} });
+
+	for (int i = 0; i < 1000; i++)
+		EXPECT_EQ(formulas[i].calculate(), i + 1.0);
+}
+
+TEST(expression, can_calculate_with_binding_frame) {
+	const expression ex("(a-b)*c+a");
+	std::vector<std::string> names = ex.get_variables();
+	double frame[3];
+	for (size_t i = 0; i < names.size(); i++)
+		frame[i] = names[i] == "a" ? 5 : names[i] == "b" ? 3 : 4;
+
+	EXPECT_EQ(ex.calculate(frame), 13.0);
+}
+
+TEST(expression, can_share_const_ex_between_threads) {
+	const expression ex("(a-b)*(a+b)/2");
+	std::vector<std::thread> threads;
+	std::vector<int> mismatches(8, 0);
+
+	for (size_t t = 0; t < mismatches.size(); t++) {
+		threads.emplace_back([&ex, &mismatches, t] {
+			for (int i = 0; i < 10000; i++) {
+				double frame[2] = { t + i * 0.5, 1.0 * i };
+				if (ex.calculate(frame) != (frame[0] - frame[1]) * (frame[0] + frame[1]) / 2)
+					mismatches[t]++;
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	for (int count : mismatches)
+		EXPECT_EQ(count, 0);
+}
+
+TEST(expression, can_calculate_ex_with_exponent_notation) {
+	expression ex("1.5e-9*2+2E+3-(-4e1)");
+
+	EXPECT_EQ(ex.calculate(), 1.5e-9 * 2 + 2E+3 + 4e1);
+}
+
+TEST(expression, constant_e_is_not_an_exponent) {
+	expression ex("2*e+e");
+
+	EXPECT_EQ(ex.calculate(), 3 * 2.71828182845904523536);
+}
+
+TEST(expression, throw_ex_with_incomplete_exponent) {
+	ASSERT_ANY_THROW(expression ex("1e"));
+	ASSERT_ANY_THROW(expression ex("1e+"));
+	ASSERT_ANY_THROW(expression ex("1.e5"));
+	ASSERT_ANY_THROW(expression ex("1e5e"));
+}
+
+TEST(expression, throw_ex_with_literal_out_of_range) {
+	ASSERT_ANY_THROW(expression ex("1e400*x"));
+}
+
+TEST(expression, can_parse_deeply_nested_brackets) {
+	const size_t depth = 200000;
+	std::string infix = std::string(depth, '(') + "-a" + std::string(depth, ')') + "*2";
+	expression ex(infix, { {"a", 1.5} });
+
+	EXPECT_EQ(ex.calculate(), -3.0);
+}
+
+TEST(expression, builds_postfix_with_mixed_brackets_and_unary_minus) {
+	expression ex("-{a-[b*(-c+2)]/4}-d");
+
+	EXPECT_EQ(ex.get_postfix(), "abc-2+*4/--d-");
+}
+
+TEST(expression, evaluate_matches_compiled_calculation) {
+	const char* formulas[] = { "-{a-[b*(-c+2)]/4}-d", "(a-b)/(a-b+c)*(a-b)", "1.5e-3*pi-e/a", "-7", "-(a)*2.5" };
+
+	for (const char* formula : formulas) {
+		expression ex(formula, { {"a", 1.5}, {"b", -2}, {"c", 3}, {"d", 0.25} });
+		EXPECT_EQ(expression::evaluate(formula, { {"a", 1.5}, {"b", -2}, {"c", 3}, {"d", 0.25} }), ex.calculate()) << formula;
+	}
+}
+
+TEST(expression, evaluate_reports_errors_like_calculate) {
+	EXPECT_EQ(expression::try_evaluate("1/(a-a)", { {"a", 2} }).error().code, error_code::division_by_zero);
+	EXPECT_EQ(expression::try_evaluate("x/0+y").error().code, error_code::variable_was_not_input);
+	EXPECT_EQ(expression::try_evaluate("1/0+*2").error().code, error_code::incorrect_input);
+	EXPECT_EQ(expression::try_evaluate("1/0+*2").error().position, 4);
+	EXPECT_EQ(expression::try_evaluate("pi*2", { {"pi", 3} }).error().code, error_code::constant_was_bound);
+	ASSERT_ANY_THROW(expression::evaluate("(1+2"));
+}
+
+TEST(expression, evaluate_resolves_each_variable_once) {
+	class counting_resolver : public resolver {
+	public:
+		int calls = 0;
+		double resolve(const std::string& name) override {
+			calls++;
+			return name == "a" ? 2 : 3;
+		}
+		using resolver::resolve;
+	} source;
+
+	EXPECT_EQ(expression::evaluate("a*b+a*a", source), 10.0);
+	EXPECT_EQ(source.calls, 2);
+}
+
+TEST(expression, evaluate_handles_deep_nesting) {
+	const size_t depth = 1000;
+	std::string infix = std::string(depth, '(') + "1" + std::string(depth, ')');
+	for (size_t i = 0; i < 200; i++)
+		infix = "1+(" + infix + "*2)";
+
+	EXPECT_EQ(expression::evaluate(infix), expression(infix).calculate());
+}
@@ -0,0 +1,104 @@
+#include "expression_cache.h"
+#include <gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(expression_cache, can_find_inserted_program) {
+	expression_cache cache;
+	auto program = std::make_shared<const expression::compiled>("a+b");
+
+	cache.insert("a+b", program);
+
+	EXPECT_EQ(cache.find("a+b"), program);
+	EXPECT_EQ(cache.get_statistics().hits, 1);
+}
+
+TEST(expression_cache, miss_on_unknown_infix) {
+	expression_cache cache;
+
+	EXPECT_EQ(cache.find("a+b"), nullptr);
+	EXPECT_EQ(cache.get_statistics().misses, 1);
+}
+
+TEST(expression_cache, evicts_least_recently_used_over_budget) {
+	auto first = std::make_shared<const expression::compiled>("a+b");
+	auto second = std::make_shared<const expression::compiled>("a-b");
+	auto third = std::make_shared<const expression::compiled>("a*b");
+	expression_cache cache(first->memory_size() * 3, 1);
+
+	cache.insert("a+b", first);
+	cache.insert("a-b", second);
+	cache.find("a+b");
+	cache.insert("a*b", third);
+
+	EXPECT_EQ(cache.find("a+b"), first);
+	EXPECT_EQ(cache.find("a-b"), nullptr);
+	EXPECT_EQ(cache.find("a*b"), third);
+	EXPECT_EQ(cache.get_statistics().evictions, 1);
+}
+
+TEST(expression_cache, smaller_budget_evicts_entries) {
+	expression_cache cache;
+
+	cache.insert("a+b", std::make_shared<const expression::compiled>("a+b"));
+	cache.insert("a-b", std::make_shared<const expression::compiled>("a-b"));
+	cache.set_budget(0);
+
+	EXPECT_EQ(cache.get_statistics().entries, 0);
+	EXPECT_EQ(cache.get_statistics().bytes, 0);
+}
+
+TEST(expression_cache, can_clear) {
+	expression_cache cache;
+
+	cache.insert("a+b", std::make_shared<const expression::compiled>("a+b"));
+	cache.clear();
+
+	EXPECT_EQ(cache.find("a+b"), nullptr);
+}
+
+TEST(expression_cache, expression_reuses_cached_program) {
+	expression first("cache_x*cache_y+1");
+	size_t hits = expression_cache::instance().get_statistics().hits;
+	expression second("cache_x*cache_y+1");
+
+	EXPECT_EQ(expression_cache::instance().get_statistics().hits, hits + 1);
+	EXPECT_EQ(second.get_postfix(), first.get_postfix());
+}
+
+TEST(expression_cache, cached_expressions_keep_own_variables) {
+	expression first("cache_z+1", { {"cache_z", 1} });
+	expression second("cache_z+1", { {"cache_z", 2} });
+
+	EXPECT_EQ(first.calculate(), 2);
+	EXPECT_EQ(second.calculate(), 3);
+}
+
+TEST(expression_cache, incorrect_input_is_not_cached) {
+	size_t entries = expression_cache::instance().get_statistics().entries;
+
+	ASSERT_ANY_THROW(expression("cache_a+"));
+	EXPECT_EQ(expression_cache::instance().get_statistics().entries, entries);
+}
+
+TEST(expression_cache, can_share_cache_between_threads) {
+	expression_cache cache(expression_cache::default_budget, 4);
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&cache] {
+			for (int i = 0; i < 1000; i++) {
+				std::string infix = "x+" + std::to_string(i % 50);
+				if (!cache.find(infix))
+					cache.insert(infix, std::make_shared<const expression::compiled>(infix));
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	auto stats = cache.get_statistics();
+	EXPECT_EQ(stats.hits + stats.misses, 4000);
+	EXPECT_EQ(stats.entries, 50);
+}
@@ -0,0 +1,96 @@
+#include "expression.h"
+#include "expression_cache.h"
+#include "instrumentation.h"
+#include <gtest.h>
+
+#include <thread>
+
+using instrumentation::counter;
+using instrumentation::phase;
+
+static const instrumentation::phase_statistics& of(const instrumentation::snapshot& taken, phase measured) {
+	return taken.phases[(size_t)measured];
+}
+
+static const instrumentation::counter_statistics& of(const instrumentation::snapshot& taken, counter measured) {
+	return taken.counters[(size_t)measured];
+}
+
+TEST(instrumentation, can_name_phases_and_counters) {
+	EXPECT_STREQ(instrumentation::name(phase::optimize), "optimize");
+	EXPECT_STREQ(instrumentation::name(counter::stack_depth), "stack_depth");
+}
+
+TEST(instrumentation, records_parse_phases) {
+	instrumentation::reset();
+
+	expression_cache::instance().set_budget(0);
+	expression ex("(instrumented_a+1)*instrumented_b");
+	expression_cache::instance().set_budget(expression_cache::default_budget);
+	instrumentation::snapshot taken = instrumentation::collect();
+
+	if (!instrumentation::enabled) {
+		EXPECT_EQ(of(taken, phase::scan).calls, 0);
+		return;
+	}
+	for (phase measured : { phase::scan, phase::optimize })
+		EXPECT_EQ(of(taken, measured).calls, 1);
+	EXPECT_GT(of(taken, phase::scan).allocations, 0);
+	EXPECT_EQ(of(taken, counter::tokens).total, 7);
+	EXPECT_EQ(of(taken, counter::postfix_length).total, 5);
+	EXPECT_EQ(of(taken, counter::stack_depth).maximum, 2);
+}
+
+TEST(instrumentation, evaluate_does_not_allocate) {
+	instrumentation::reset();
+
+	double value = expression::evaluate("(a+1)*{b-[2.5e1/c]}-pi", { {"a", 1}, {"b", 2}, {"c", 4} });
+	instrumentation::snapshot taken = instrumentation::collect();
+
+	EXPECT_EQ(value, 2 * (2 - 25 / 4.0) - 3.14159265358979323846);
+	if (instrumentation::enabled) {
+		EXPECT_EQ(of(taken, phase::evaluate).calls, 1);
+		EXPECT_EQ(of(taken, phase::evaluate).allocations, 0);
+	}
+}
+
+TEST(instrumentation, scan_does_not_allocate_per_token) {
+	std::string infix = "x_scan";
+	for (int i = 0; i < 2500; i++)
+		infix += "+(y_scan*" + std::to_string(i) + "-z_scan)";
+
+	instrumentation::reset();
+	expression::compiled program(infix);
+	instrumentation::snapshot taken = instrumentation::collect();
+
+	if (instrumentation::enabled) {
+		EXPECT_GT(of(taken, counter::tokens).total, 10000);
+		// only the program, literals and slots grow, each by doubling
+		EXPECT_LT(of(taken, phase::scan).allocations, 100);
+	}
+}
+
+TEST(instrumentation, collects_counters_of_finished_threads) {
+	instrumentation::reset();
+
+	std::thread worker([] {
+		expression ex("a*2", { {"a", 4} });
+		for (int i = 0; i < 10; i++)
+			ex.calculate();
+	});
+	worker.join();
+	instrumentation::snapshot taken = instrumentation::collect();
+
+	EXPECT_EQ(of(taken, phase::calculate).calls, instrumentation::enabled ? 10 : 0);
+}
+
+TEST(instrumentation, counts_batch_rows) {
+	instrumentation::reset();
+	expression ex("a+1");
+	std::vector<double> a(100, 1.0), result(100);
+
+	ex.calculate({ { a.data() } }, result.data(), a.size());
+	instrumentation::snapshot taken = instrumentation::collect();
+
+	EXPECT_EQ(of(taken, counter::rows).total, instrumentation::enabled ? 100 : 0);
+}
@@ -0,0 +1,86 @@
+#include "jit.h"
+#include <gtest.h>
+
+#include <vector>
+
+TEST(jit, can_compile_and_run_scalar_function) {
+	if (!jit::is_available())
+		return;
+	// (slot0 + 2.5) * -slot1 / slot0
+	auto code = jit::compile({ {jit::kind::load_slot, 0, 0}, {jit::kind::load_literal, 0, 2.5}, {jit::kind::add, 0, 0},
+		{jit::kind::load_slot, 1, 0}, {jit::kind::negate, 0, 0}, {jit::kind::mul, 0, 0},
+		{jit::kind::load_slot, 0, 0}, {jit::kind::div, 0, 0} });
+	ASSERT_NE(code, nullptr);
+
+	double slots[] = { 2, 3 };
+	unsigned int division_by_zero = 1;
+	EXPECT_EQ(code->scalar(slots, &division_by_zero, nullptr), (2 + 2.5) * -3 / 2);
+	EXPECT_EQ(division_by_zero, 0);
+}
+
+TEST(jit, can_run_batch_function) {
+	if (!jit::is_available())
+		return;
+	auto code = jit::compile({ {jit::kind::load_slot, 0, 0}, {jit::kind::load_slot, 1, 0}, {jit::kind::sub, 0, 0},
+		{jit::kind::load_literal, 0, 0.5}, {jit::kind::mul, 0, 0} });
+	ASSERT_NE(code, nullptr);
+
+	std::vector<double> a = { 1, 2, 3, 4, 5, 6 }, b = { 6, 5, 4, 3, 2, 1 }, result(6);
+	const double* columns[] = { a.data(), b.data() };
+	unsigned int division_by_zero = 1;
+	code->batch(columns, result.data(), 3, &division_by_zero, nullptr);
+
+	for (size_t i = 0; i < a.size(); i++)
+		EXPECT_EQ(result[i], (a[i] - b[i]) * 0.5);
+	EXPECT_EQ(division_by_zero, 0);
+}
+
+TEST(jit, reports_division_by_zero) {
+	if (!jit::is_available())
+		return;
+	auto code = jit::compile({ {jit::kind::load_literal, 0, 1}, {jit::kind::load_slot, 0, 0}, {jit::kind::div, 0, 0} });
+	ASSERT_NE(code, nullptr);
+
+	double zero[] = { 0 };
+	unsigned int division_by_zero = 0;
+	code->scalar(zero, &division_by_zero, nullptr);
+	EXPECT_NE(division_by_zero, 0);
+
+	double values[] = { 1, 0 };
+	const double* columns[] = { values };
+	double result[2];
+	division_by_zero = 0;
+	code->batch(columns, result, 1, &division_by_zero, nullptr);
+	EXPECT_NE(division_by_zero, 0);
+}
+
+TEST(jit, can_store_and_load_temps) {
+	if (!jit::is_available())
+		return;
+	// t = slot0 - slot1; t * t
+	auto code = jit::compile({ {jit::kind::load_slot, 0, 0}, {jit::kind::load_slot, 1, 0}, {jit::kind::sub, 0, 0},
+		{jit::kind::store_temp, 0, 0}, {jit::kind::load_temp, 0, 0}, {jit::kind::mul, 0, 0} });
+	ASSERT_NE(code, nullptr);
+
+	double slots[] = { 5, 2 };
+	double temps[2];
+	unsigned int division_by_zero = 0;
+	EXPECT_EQ(code->scalar(slots, &division_by_zero, temps), 9.0);
+
+	double a[] = { 5, 1 }, b[] = { 2, 4 };
+	const double* columns[] = { a, b };
+	double result[2];
+	code->batch(columns, result, 1, &division_by_zero, temps);
+	EXPECT_EQ(result[0], 9.0);
+	EXPECT_EQ(result[1], 9.0);
+}
+
+TEST(jit, refuses_programs_deeper_than_registers) {
+	std::vector<jit::operation> program;
+	for (size_t i = 0; i <= jit::max_depth; i++)
+		program.push_back({ jit::kind::load_literal, 0, 1.0 * i });
+	for (size_t i = 0; i < jit::max_depth; i++)
+		program.push_back({ jit::kind::add, 0, 0 });
+
+	EXPECT_EQ(jit::compile(program), nullptr);
+}
@@ -0,0 +1,64 @@
+#include "kernels.h"
+#include <gtest.h>
+
+#include <vector>
+
+static const kernels::isa all_sets[] = { kernels::isa::scalar, kernels::isa::sse2, kernels::isa::avx2, kernels::isa::avx512 };
+
+TEST(kernels, scalar_is_always_supported) {
+	EXPECT_TRUE(kernels::is_supported(kernels::isa::scalar));
+	EXPECT_TRUE(kernels::is_supported(kernels::best_isa()));
+}
+
+TEST(kernels, throw_if_selected_set_is_not_supported) {
+	for (kernels::isa set : all_sets) {
+		if (!kernels::is_supported(set)) {
+			ASSERT_ANY_THROW(kernels::select(set));
+		}
+	}
+}
+
+TEST(kernels, all_supported_sets_match_scalar) {
+	const size_t count = 37;
+	std::vector<double> first(count), second(count);
+	for (size_t i = 0; i < count; i++) {
+		first[i] = i * 1.25 - 7;
+		second[i] = 3.5 - i * 0.75 + (i == 14 ? 0.0 : 0.001);
+	}
+
+	for (kernels::isa set : all_sets) {
+		if (!kernels::is_supported(set))
+			continue;
+		const kernels::table& kernel = kernels::get(set);
+		std::vector<double> add = first, sub = first, mul = first, div = first, negate = first;
+
+		kernel.add(add.data(), second.data(), count);
+		kernel.sub(sub.data(), second.data(), count);
+		kernel.mul(mul.data(), second.data(), count);
+		EXPECT_FALSE(kernel.div(div.data(), second.data(), count));
+		kernel.negate(negate.data(), count);
+
+		for (size_t i = 0; i < count; i++) {
+			EXPECT_EQ(add[i], first[i] + second[i]) << kernels::name(set);
+			EXPECT_EQ(sub[i], first[i] - second[i]) << kernels::name(set);
+			EXPECT_EQ(mul[i], first[i] * second[i]) << kernels::name(set);
+			EXPECT_EQ(div[i], first[i] / second[i]) << kernels::name(set);
+			EXPECT_EQ(negate[i], -first[i]) << kernels::name(set);
+		}
+	}
+}
+
+TEST(kernels, div_reports_zero_in_any_lane) {
+	const size_t count = 19;
+
+	for (kernels::isa set : all_sets) {
+		if (!kernels::is_supported(set))
+			continue;
+		for (size_t zero_lane : { (size_t)0, (size_t)5, count - 1 }) {
+			std::vector<double> first(count, 1.0), second(count, 2.0);
+			second[zero_lane] = 0;
+
+			EXPECT_TRUE(kernels::get(set).div(first.data(), second.data(), count)) << kernels::name(set) << " lane " << zero_lane;
+		}
+	}
+}
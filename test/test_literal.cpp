@@ -0,0 +1,66 @@
+#include "literal.h"
+#include <gtest.h>
+
+#include <clocale>
+#include <cstdlib>
+#include <string>
+
+TEST(literal, can_parse_integers_and_fractions) {
+	double value = 0;
+
+	ASSERT_TRUE(literal::parse("42", value));
+	EXPECT_EQ(value, 42.0);
+	ASSERT_TRUE(literal::parse("-0.125", value));
+	EXPECT_EQ(value, -0.125);
+	ASSERT_TRUE(literal::parse("3.14159265358979323846", value));
+	EXPECT_EQ(value, 3.14159265358979323846);
+}
+
+TEST(literal, can_parse_exponents) {
+	double value = 0;
+
+	ASSERT_TRUE(literal::parse("1.5e-9", value));
+	EXPECT_EQ(value, 1.5e-9);
+	ASSERT_TRUE(literal::parse("2E+3", value));
+	EXPECT_EQ(value, 2000.0);
+	ASSERT_TRUE(literal::parse("-7e300", value));
+	EXPECT_EQ(value, -7e300);
+	ASSERT_TRUE(literal::parse("1e00005", value));
+	EXPECT_EQ(value, 1e5);
+}
+
+TEST(literal, rounds_like_strtod) {
+	const char* texts[] = { "0.1", "0.3", "123456789012345678901", "9007199254740993", "2.2250738585072014e-308",
+		"1.7976931348623157e308", "4.9e-324", "0.000000000000000000000000000001", "1e23", "8.589973e9" };
+	double value = 0;
+
+	for (const char* text : texts) {
+		ASSERT_TRUE(literal::parse(text, value)) << text;
+		EXPECT_EQ(value, std::strtod(text, nullptr)) << text;
+	}
+}
+
+TEST(literal, rejects_malformed_and_out_of_range_text) {
+	double value = 0;
+
+	EXPECT_FALSE(literal::parse("", value));
+	EXPECT_FALSE(literal::parse("1e", value));
+	EXPECT_FALSE(literal::parse("1e+", value));
+	EXPECT_FALSE(literal::parse("1.5x", value));
+	EXPECT_FALSE(literal::parse("1e400", value));
+}
+
+TEST(literal, does_not_depend_on_locale) {
+	double value = 0;
+	const char* previous = std::setlocale(LC_NUMERIC, nullptr);
+	std::string saved = previous != nullptr ? previous : "C";
+
+	// a locale with a decimal comma, if the system has one
+	if (std::setlocale(LC_NUMERIC, "de_DE.UTF-8") == nullptr)
+		std::setlocale(LC_NUMERIC, "fr_FR.UTF-8");
+	bool parsed = literal::parse("0.5", value);
+	std::setlocale(LC_NUMERIC, saved.c_str());
+
+	ASSERT_TRUE(parsed);
+	EXPECT_EQ(value, 0.5);
+}
@@ -0,0 +1,246 @@
+#include "expression_cache.h"
+#include "program_file.h"
+#include <gtest.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+static std::string temporary_path(const char* name) {
+	return std::string("test_program_file_") + name + ".bin";
+}
+
+static std::vector<unsigned char> read_bytes(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_bytes(const std::string& path, const std::vector<unsigned char>& bytes) {
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+class program_file_layout {
+	using header = program_file::header;
+	using record = program_file::record;
+
+	static size_t record_offset(const std::vector<unsigned char>& bytes, const std::string& infix) {
+		const header* head = reinterpret_cast<const header*>(bytes.data());
+		for (size_t i = 0; i < head->count; i++) {
+			const record* r = reinterpret_cast<const record*>(bytes.data() + sizeof(header)) + i;
+			if (std::string(reinterpret_cast<const char*>(bytes.data() + r->infix.offset), r->infix.length) == infix)
+				return sizeof(header) + i * sizeof(record);
+		}
+		throw "no such record";
+	}
+
+public:
+	static void set_buckets(std::vector<unsigned char>& bytes, uint64_t buckets) {
+		std::memcpy(bytes.data() + offsetof(header, buckets), &buckets, sizeof(buckets));
+	}
+
+	// leaves every checksum as it was
+	static void damage_program(std::vector<unsigned char>& bytes, const std::string& infix) {
+		const record* r = reinterpret_cast<const record*>(bytes.data() + record_offset(bytes, infix));
+		bytes[r->program + 4] ^= 0x5a;
+	}
+
+	// and fixes the checksums, so only the checks of the program itself can reject it
+	static void rewrite_first_instruction(std::vector<unsigned char>& bytes, const std::string& infix, uint32_t code, uint32_t index) {
+		record* r = reinterpret_cast<record*>(bytes.data() + record_offset(bytes, infix));
+		std::memcpy(bytes.data() + r->program, &code, sizeof(code));
+		std::memcpy(bytes.data() + r->program + sizeof(code), &index, sizeof(index));
+		r->checksum = program_file::record_checksum(bytes.data(), *r);
+
+		uint64_t checksum = program_file::checksum(bytes.data() + sizeof(header), bytes.size() - sizeof(header));
+		std::memcpy(bytes.data() + offsetof(header, checksum), &checksum, sizeof(checksum));
+	}
+};
+
+static void rewrite_first_instruction(const std::string& path, const std::string& infix, uint32_t code, uint32_t index) {
+	std::vector<unsigned char> bytes = read_bytes(path);
+	program_file_layout::rewrite_first_instruction(bytes, infix, code, index);
+	write_bytes(path, bytes);
+}
+
+TEST(program_file, can_find_written_programs) {
+	std::string path = temporary_path("find");
+	ASSERT_EQ(program_file::write(path, { "a+b*c", "(x-1)/pi", "(a+b)*(a+b)" }), 3);
+
+	program_file file(path);
+	auto program = file.find("(a+b)*(a+b)");
+	auto parsed = std::make_shared<const expression::compiled>("(a+b)*(a+b)");
+
+	EXPECT_EQ(file.size(), 3);
+	ASSERT_NE(program, nullptr);
+	EXPECT_EQ(program->postfix_str, parsed->postfix_str);
+	EXPECT_EQ(program->slots, parsed->slots);
+	EXPECT_EQ(program->literals, parsed->literals);
+	EXPECT_EQ(program->program.size(), parsed->program.size());
+	EXPECT_EQ(program->stack_depth, parsed->stack_depth);
+	EXPECT_EQ(program->temp_count, parsed->temp_count);
+	std::remove(path.c_str());
+}
+
+TEST(program_file, miss_on_unknown_infix) {
+	std::string path = temporary_path("miss");
+	program_file::write(path, { "a+b" });
+
+	program_file file(path);
+
+	EXPECT_EQ(file.find("a-b"), nullptr);
+	std::remove(path.c_str());
+}
+
+TEST(program_file, skips_incorrect_and_repeated_input) {
+	std::string path = temporary_path("skip");
+
+	EXPECT_EQ(program_file::write(path, { "a+b", "a+", "a+b", "" }), 1);
+	std::remove(path.c_str());
+}
+
+TEST(program_file, throw_if_file_is_corrupted) {
+	std::string path = temporary_path("corrupted");
+	program_file::write(path, { "a+b*c" });
+	std::vector<unsigned char> bytes = read_bytes(path);
+	program_file_layout::damage_program(bytes, "a+b*c");
+	write_bytes(path, bytes);
+
+	program_file file(path);
+
+	ASSERT_ANY_THROW(file.verify());
+	ASSERT_ANY_THROW(file.find("a+b*c"));
+	std::remove(path.c_str());
+}
+
+TEST(program_file, damaged_record_does_not_hide_others) {
+	std::string path = temporary_path("damaged");
+	program_file::write(path, { "a+b", "c*d" });
+	std::vector<unsigned char> bytes = read_bytes(path);
+	program_file_layout::damage_program(bytes, "a+b");
+	write_bytes(path, bytes);
+
+	program_file file(path);
+
+	ASSERT_ANY_THROW(file.find("a+b"));
+	EXPECT_NE(file.find("c*d"), nullptr);
+	std::remove(path.c_str());
+}
+
+TEST(program_file, written_file_verifies) {
+	std::string path = temporary_path("verify");
+	program_file::write(path, { "a+b", "c*d", "(e-f)/2" });
+
+	program_file file(path);
+
+	file.verify();
+	std::remove(path.c_str());
+}
+
+TEST(program_file, repeated_find_returns_loaded_program) {
+	std::string path = temporary_path("repeat");
+	program_file::write(path, { "a*b-c" });
+
+	program_file file(path);
+	auto program = file.find("a*b-c");
+
+	ASSERT_NE(program, nullptr);
+	EXPECT_EQ(file.find("a*b-c"), program);
+	std::remove(path.c_str());
+}
+
+TEST(program_file, throw_if_file_is_missing) {
+	ASSERT_ANY_THROW(program_file file(temporary_path("missing")));
+}
+
+TEST(program_file, expression_loads_attached_programs) {
+	std::string path = temporary_path("attach");
+	program_file::write(path, { "file_a*2-file_b" });
+	expression_cache cache;
+	cache.attach(std::make_shared<const program_file>(path));
+
+	auto program = cache.find("file_a*2-file_b");
+
+	ASSERT_NE(program, nullptr);
+	EXPECT_EQ(cache.get_statistics().loads, 1);
+	EXPECT_EQ(cache.find("file_a*2-file_b"), program);
+	std::remove(path.c_str());
+}
+
+TEST(program_file, detached_file_is_not_searched) {
+	std::string path = temporary_path("detach");
+	program_file::write(path, { "file_c+1" });
+	expression_cache cache;
+	auto file = std::make_shared<const program_file>(path);
+	cache.attach(file);
+	cache.detach(file);
+
+	EXPECT_EQ(cache.find("file_c+1"), nullptr);
+	EXPECT_EQ(cache.get_statistics().loads, 0);
+	std::remove(path.c_str());
+}
+
+TEST(program_file, calculates_same_as_parsed_expression) {
+	std::string path = temporary_path("calculate");
+	program_file::write(path, { "file_x*(file_y+1)/file_x-(file_y+1)" });
+	auto file = std::make_shared<const program_file>(path);
+	expression_cache::instance().attach(file);
+	size_t loads = expression_cache::instance().get_statistics().loads;
+
+	expression ex("file_x*(file_y+1)/file_x-(file_y+1)", { {"file_x", 4}, {"file_y", 2.5} });
+
+	EXPECT_EQ(expression_cache::instance().get_statistics().loads, loads + 1);
+	EXPECT_EQ(ex.calculate(), 0.0);
+	expression_cache::instance().detach(file);
+	std::remove(path.c_str());
+}
+
+TEST(program_file, throw_if_instruction_index_is_out_of_range) {
+	std::string path = temporary_path("index");
+	program_file::write(path, { "a+b" });
+	rewrite_first_instruction(path, "a+b", 1, 0x40000000);
+
+	program_file file(path);
+
+	ASSERT_ANY_THROW(file.find("a+b"));
+	std::remove(path.c_str());
+}
+
+TEST(program_file, throw_if_opcode_is_unknown) {
+	std::string path = temporary_path("opcode");
+	program_file::write(path, { "a+b" });
+	// would wrap around to a valid opcode if it were cast before it is checked
+	rewrite_first_instruction(path, "a+b", 256 + 5, 0);
+
+	program_file file(path);
+
+	ASSERT_ANY_THROW(file.find("a+b"));
+	std::remove(path.c_str());
+}
+
+TEST(program_file, throw_if_program_underflows_stack) {
+	std::string path = temporary_path("underflow");
+	program_file::write(path, { "a+b" });
+	// an add with nothing on the stack
+	rewrite_first_instruction(path, "a+b", 5, 0);
+
+	program_file file(path);
+
+	ASSERT_ANY_THROW(file.find("a+b"));
+	std::remove(path.c_str());
+}
+
+TEST(program_file, throw_if_bucket_count_does_not_fit_file) {
+	std::string path = temporary_path("buckets");
+	program_file::write(path, { "a+b" });
+	std::vector<unsigned char> bytes = read_bytes(path);
+	// buckets * 4 wraps around to 0 here
+	program_file_layout::set_buckets(bytes, uint64_t(1) << 62);
+	write_bytes(path, bytes);
+
+	ASSERT_ANY_THROW(program_file file(path));
+	std::remove(path.c_str());
+}
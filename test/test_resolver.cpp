@@ -0,0 +1,91 @@
+#include "expression.h"
+#include <gtest.h>
+
+#include <atomic>
+#include <map>
+#include <sstream>
+
+class map_resolver : public resolver {
+public:
+	std::map<std::string, double> values;
+	std::atomic<int> single_calls{ 0 };
+	std::atomic<int> batch_calls{ 0 };
+
+	double resolve(const std::string& name) override {
+		single_calls++;
+		return values.at(name);
+	}
+
+	void resolve(const std::vector<std::string>& names, double* result) override {
+		batch_calls++;
+		resolver::resolve(names, result);
+	}
+};
+
+TEST(resolver, stream_input_does_not_request_variables) {
+	std::istringstream in("a+b*c");
+	expression ex;
+
+	in >> ex;
+
+	EXPECT_EQ(ex.get_unbound_variables(), std::vector<std::string>({ "a", "b", "c" }));
+}
+
+TEST(resolver, console_resolver_reads_variables) {
+	std::istringstream values("3 4");
+	std::ostringstream prompts;
+	console_resolver console(values, prompts);
+	expression ex("a-b");
+
+	ex.resolve(console);
+
+	EXPECT_EQ(ex.calculate(), -1.0);
+	EXPECT_NE(prompts.str().find("a = "), std::string::npos);
+}
+
+TEST(resolver, throw_if_console_input_is_not_number) {
+	std::istringstream values("x");
+	std::ostringstream prompts;
+	console_resolver console(values, prompts);
+	expression ex("a-b");
+
+	ASSERT_ANY_THROW(ex.resolve(console));
+}
+
+TEST(resolver, resolves_only_unbound_variables_in_one_batch) {
+	map_resolver source;
+	source.values = { {"b", 2}, {"c", 5} };
+	expression ex("a*b+c", { {"a", 3} });
+
+	ex.resolve(source);
+
+	EXPECT_EQ(ex.calculate(), 11.0);
+	EXPECT_EQ(source.batch_calls, 1);
+	EXPECT_EQ(source.single_calls, 2);
+}
+
+TEST(resolver, can_resolve_asynchronously) {
+	map_resolver source;
+	source.values = { {"x", 1.5}, {"y", 2} };
+	std::vector<expression> formulas = { expression("x*y"), expression("x+y"), expression("y/x+1") };
+	std::vector<std::future<void>> pending;
+
+	for (auto& ex : formulas)
+		pending.push_back(ex.resolve_async(source));
+	for (auto& fetch : pending)
+		fetch.get();
+
+	EXPECT_EQ(formulas[0].calculate(), 3.0);
+	EXPECT_EQ(formulas[1].calculate(), 3.5);
+	EXPECT_DOUBLE_EQ(formulas[2].calculate(), 2 / 1.5 + 1);
+}
+
+TEST(resolver, nothing_is_resolved_when_all_variables_are_input) {
+	map_resolver source;
+	expression ex("a+1", { {"a", 1} });
+
+	ex.resolve_async(source).get();
+
+	EXPECT_EQ(source.batch_calls, 0);
+	EXPECT_EQ(ex.calculate(), 2.0);
+}
@@ -0,0 +1,180 @@
+#include "expression.h"
+#include <gtest.h>
+
+#include <cmath>
+
+TEST(result, try_parse_returns_expression) {
+	result<expression> parsed = expression::try_parse("(a+1)*2");
+
+	ASSERT_TRUE(parsed.has_value());
+	EXPECT_EQ(parsed->get_variables(), std::vector<std::string>{ "a" });
+}
+
+TEST(result, try_parse_reports_position_of_unexpected_char) {
+	result<expression> parsed = expression::try_parse("1+2**3");
+
+	ASSERT_FALSE(parsed.has_value());
+	EXPECT_EQ(parsed.error().code, error_code::incorrect_input);
+	EXPECT_EQ(parsed.error().position, 4);
+	EXPECT_STREQ(parsed.error().message(), "incorrect input");
+}
+
+TEST(result, try_parse_reports_position_of_unclosed_bracket) {
+	result<expression> parsed = expression::try_parse("1+(2*[3+4]");
+
+	ASSERT_FALSE(parsed.has_value());
+	EXPECT_EQ(parsed.error().position, 2);
+}
+
+TEST(result, try_parse_reports_position_of_mismatched_bracket) {
+	result<expression> parsed = expression::try_parse("(1+2]");
+
+	ASSERT_FALSE(parsed.has_value());
+	EXPECT_EQ(parsed.error().position, 4);
+}
+
+TEST(result, try_parse_reports_incomplete_input_at_end) {
+	result<expression> parsed = expression::try_parse("1+");
+
+	ASSERT_FALSE(parsed.has_value());
+	EXPECT_EQ(parsed.error().position, 2);
+}
+
+TEST(result, try_parse_reports_number_out_of_range) {
+	result<expression> parsed = expression::try_parse("x+1e999");
+
+	ASSERT_FALSE(parsed.has_value());
+	EXPECT_EQ(parsed.error().code, error_code::number_out_of_range);
+	EXPECT_EQ(parsed.error().position, 2);
+}
+
+TEST(result, value_throws_message_of_error) {
+	result<expression> parsed = expression::try_parse("(");
+
+	ASSERT_ANY_THROW(parsed.value());
+}
+
+TEST(result, try_calculate_returns_value) {
+	expression ex("a/b", { {"a", 3}, {"b", 2} });
+
+	EXPECT_EQ(ex.try_calculate().value(), 1.5);
+}
+
+TEST(result, try_calculate_reports_division_by_zero) {
+	expression ex("a/(b-2)", { {"a", 3}, {"b", 2} });
+	result<double> value = ex.try_calculate();
+
+	ASSERT_FALSE(value.has_value());
+	EXPECT_EQ(value.error().code, error_code::division_by_zero);
+	EXPECT_EQ(value.value_or(-1), -1);
+}
+
+TEST(result, try_calculate_reports_unbound_variable) {
+	expression ex("a+b", { {"a", 3} });
+
+	EXPECT_EQ(ex.try_calculate().error().code, error_code::variable_was_not_input);
+}
+
+TEST(result, try_calculate_reports_the_error_reached_first) {
+	EXPECT_EQ(expression("0.5/0*E").try_calculate().error().code, error_code::division_by_zero);
+	EXPECT_EQ(expression("E*(0.5/0)").try_calculate().error().code, error_code::variable_was_not_input);
+	EXPECT_EQ(expression("(x/0)*(x/0)").try_calculate().error().code, error_code::variable_was_not_input);
+	EXPECT_EQ(expression::try_evaluate("0.5/0*E").error().code, error_code::division_by_zero);
+	EXPECT_EQ(expression::try_evaluate("E*(0.5/0)").error().code, error_code::variable_was_not_input);
+}
+
+TEST(result, calculate_throws_the_error_reached_first) {
+	try {
+		expression("0.5/0*E").calculate();
+		FAIL();
+	}
+	catch (const char* message) {
+		EXPECT_EQ(expression_error{ error_code::division_by_zero }.message(), std::string(message));
+	}
+}
+
+TEST(result, try_calculate_reports_empty_expression) {
+	expression ex;
+
+	EXPECT_EQ(ex.try_calculate().error().code, error_code::expression_is_empty);
+}
+
+TEST(result, try_calculate_batch_marks_rows_divided_by_zero) {
+	const size_t count = 1000;
+	std::vector<double> a(count), b(count), values(count);
+	for (size_t i = 0; i < count; i++) {
+		a[i] = (double)i;
+		b[i] = i % 7 == 0 ? 0 : (double)(i % 7);
+	}
+
+	expression ex("a/b+1");
+	row_errors errors;
+	result<size_t> failed = ex.try_calculate({ { a.data() }, { b.data() } }, values.data(), count, errors);
+
+	ASSERT_TRUE(failed.has_value());
+	EXPECT_EQ(*failed, (count + 6) / 7);
+	ASSERT_EQ(errors.size(), count);
+	for (size_t i = 0; i < count; i++) {
+		EXPECT_EQ(errors.test(i), i % 7 == 0);
+		if (i % 7 != 0) {
+			EXPECT_EQ(values[i], a[i] / b[i] + 1);
+		}
+	}
+}
+
+TEST(result, try_calculate_batch_marks_rows_with_native_code) {
+	const size_t count = 777;
+	std::vector<double> a(count), b(count), values(count);
+	for (size_t i = 0; i < count; i++) {
+		a[i] = (double)i;
+		b[i] = i % 100 == 3 ? 0 : 2;
+	}
+
+	expression ex("a/b*2");
+	ex.compile_native();
+	row_errors errors;
+	result<size_t> failed = ex.try_calculate({ { a.data() }, { b.data() } }, values.data(), count, errors);
+
+	ASSERT_TRUE(failed.has_value());
+	EXPECT_EQ(*failed, 8);
+	for (size_t i = 0; i < count; i++) {
+		EXPECT_EQ(errors.test(i), i % 100 == 3);
+		if (i % 100 != 3) {
+			EXPECT_EQ(values[i], (double)i);
+		}
+	}
+}
+
+TEST(result, try_calculate_batch_marks_rows_in_parallel) {
+	const size_t count = 20000;
+	std::vector<double> b(count), values(count);
+	for (size_t i = 0; i < count; i++)
+		b[i] = i % 1000 == 999 ? 0 : 1;
+
+	expression ex("1/b");
+	thread_pool pool(4);
+	row_errors errors;
+	result<size_t> failed = ex.try_calculate({ { b.data() } }, values.data(), count, errors, pool);
+
+	ASSERT_TRUE(failed.has_value());
+	EXPECT_EQ(*failed, count / 1000);
+	EXPECT_TRUE(errors.test(999));
+	EXPECT_FALSE(errors.test(1000));
+	EXPECT_TRUE(std::isinf(values[999]));
+}
+
+TEST(result, try_calculate_batch_reports_wrong_columns) {
+	expression ex("a+b");
+	row_errors errors;
+	double values[1];
+
+	EXPECT_EQ(ex.try_calculate({ { nullptr } }, values, 1, errors).error().code, error_code::wrong_number_of_columns);
+}
+
+TEST(result, throwing_batch_still_throws_on_division_by_zero) {
+	std::vector<double> b = { 1, 0, 1 };
+	std::vector<double> values(3);
+	expression ex("1/b");
+
+	ASSERT_ANY_THROW(ex.calculate({ { b.data() } }, values.data(), 3));
+}
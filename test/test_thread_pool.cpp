@@ -0,0 +1,52 @@
+#include "thread_pool.h"
+#include <gtest.h>
+
+#include <atomic>
+#include <vector>
+
+TEST(thread_pool, can_create_pool_with_given_size) {
+	thread_pool pool(3);
+
+	EXPECT_EQ(pool.size(), 3);
+}
+
+TEST(thread_pool, parallel_for_visits_every_index_once) {
+	thread_pool pool(4);
+	std::vector<std::atomic<int>> visits(10007);
+
+	pool.parallel_for(visits.size(), 100, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			visits[i]++;
+	});
+
+	for (auto& count : visits)
+		EXPECT_EQ(count, 1);
+}
+
+TEST(thread_pool, can_nest_parallel_for) {
+	thread_pool pool(2);
+	std::atomic<size_t> total{ 0 };
+
+	pool.parallel_for(8, 1, [&](size_t, size_t) {
+		pool.parallel_for(100, 10, [&](size_t begin, size_t end) {
+			total += end - begin;
+		});
+	});
+
+	EXPECT_EQ(total, 800);
+}
+
+TEST(thread_pool, rethrows_exception_from_task) {
+	thread_pool pool(2);
+
+	ASSERT_ANY_THROW(pool.parallel_for(100, 1, [](size_t begin, size_t) {
+		if (begin == 42)
+			throw "task failed";
+	}));
+}
+
+TEST(thread_pool, instance_is_shared) {
+	EXPECT_EQ(&thread_pool::instance(), &thread_pool::instance());
+	EXPECT_GE(thread_pool::instance().size(), 1);
+	ASSERT_ANY_THROW(thread_pool::configure(2));
+}